@@ -20,6 +20,22 @@ tests=(
     host 127.0.0.1;
   }|Missing port value"
 
+  # --- Global directive errors ---
+  "invalid_event_backend|event_backend kqueue;
+  server {
+    listen 8080;
+  }|Unknown event_backend"
+
+  "invalid_worker_processes|worker_processes many;
+  server {
+    listen 8080;
+  }|worker_processes must be a number or 'auto'"
+
+  "invalid_thread_dispatch|thread_dispatch random;
+  server {
+    listen 8080;
+  }|Unknown thread_dispatch 'random'"
+
   # --- Host errors ---
   "empty_host|server {
     listen 8080;
@@ -109,6 +125,12 @@ tests=(
     client_max_body_size 0;
   }|Invalid numeric value"
 
+  # --- Timeout errors ---
+  "invalid_timeout|server {
+    listen 8080;
+    header_timeout 10m;
+  }|Invalid header_timeout '10m'"
+
   # --- Location errors ---
   "location_no_path|server {
     listen 8080;
@@ -193,10 +215,17 @@ tests=(
     "unsupported_method|server {
     listen 8080;
     location / {
-        allowed_methods PUT;
+        allowed_methods PATCH;
     }
     }|unsupported HTTP method"
 
+    "put_without_upload_path|server {
+    listen 8080;
+    location / {
+        allowed_methods GET PUT;
+    }
+    }|PUT needs an upload_path"
+
   # --- Return errors ---
   "return_missing_args|server {
     listen 8080;
@@ -270,6 +299,14 @@ tests=(
     }
   }|Incorrect syntax for autoindex"
 
+  # --- File cache errors ---
+  "invalid_file_cache_size|server {
+    listen 8080;
+    location / {
+      file_cache_size 10X;
+    }
+  }|Unknown size unit in file_cache_size"
+
   # --- CGI extension errors ---
   "missing_cgi_ext|server {
     listen 8080;
@@ -298,6 +335,64 @@ tests=(
       cgi_extension .ph@p;
     }
   }|Invalid CGI extension"
+
+  "missing_cgi_interpreter|server {
+    listen 8080;
+    location / {
+      cgi_extension .rb;
+      cgi_interpreter .rb /nonexistent/ruby;
+    }
+  }|CGI interpreter '/nonexistent/ruby' not found"
+
+  "invalid_fastcgi_pass|server {
+    listen 8080;
+    location /app {
+      fastcgi_pass 127.0.0.1:99999;
+    }
+  }|Invalid fastcgi_pass address '127.0.0.1:99999'"
+
+  "cgi_pool_min_over_max|server {
+    listen 8080;
+    location /cgi-bin {
+      cgi_extension .py;
+      cgi_pool_min 4;
+      cgi_pool_max 2;
+    }
+  }|cgi_pool_min is larger than cgi_pool_max"
+
+  "cgi_queue_size_invalid|server {
+    listen 8080;
+    location /cgi-bin {
+      cgi_extension .py;
+      cgi_max_concurrent 4;
+      cgi_queue_size -1;
+    }
+  }|cgi_queue_size expects a count"
+
+  "cgi_coalesce_invalid|server {
+    listen 8080;
+    location /cgi-bin {
+      cgi_extension .py;
+      cgi_coalesce yes;
+    }
+  }|cgi_coalesce expects on or off"
+
+  "cgi_cache_valid_invalid|server {
+    listen 8080;
+    location /cgi-bin {
+      cgi_extension .py;
+      cgi_cache_size 1m;
+      cgi_cache_valid soon;
+    }
+  }|Invalid cgi_cache_valid 'soon'"
+
+  "client_body_temp_path_invalid|server {
+    listen 8080;
+    client_body_temp_path /nonexistent/bodies;
+    location / {
+      root /var/www;
+    }
+  }|client_body_temp_path '/nonexistent/bodies' is not a writable directory"
 )
 
 # --- Runner ---
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "TimerWheel.hpp"
+
+#include <pthread.h>
+
+#include <list>
+#include <map>
+#include <string>
+
+// Size-bounded LRU cache of whole CGI responses for one location, keyed by
+// method, path and query string. An entry stays fresh for the max-age or
+// Expires the script sent, else for `valid_ms`. Past that it may still be
+// served for its stale-while-revalidate window (else `stale_ms`) while one
+// request refreshes it. Shared by all event loop threads of a process.
+class CgiCache
+{
+    public:
+        enum Status {
+            MISS,
+            HIT,
+            STALE,          // serve it; a refresh is already running
+            REFRESH         // serve it, and the caller runs the refresh
+        };
+
+    private:
+        struct Entry {
+            std::string key;
+            std::string output;         // raw CGI output, header block included
+            msec_t fresh_until;
+            msec_t stale_until;
+            bool refreshing;
+        };
+        typedef std::list<Entry> EntryList;
+
+        size_t max_bytes;
+        int valid_ms;
+        int stale_ms;
+
+        pthread_mutex_t lock;
+        EntryList lru;                  // most recently used first
+        std::map<std::string, EntryList::iterator> index;
+        size_t bytes;
+
+        void erase(EntryList::iterator it);
+
+        CgiCache(const CgiCache &);
+        CgiCache &operator=(const CgiCache &);
+
+    public:
+        CgiCache(size_t max_bytes, int valid_ms, int stale_ms);
+        ~CgiCache();
+
+        // Copies the cached output unless it is a miss
+        Status lookup(const std::string &key, std::string &output);
+        // Keeps the output of a successful run if the script's headers allow
+        // it, else drops what was cached under `key`
+        void store(const std::string &key, const std::string &output);
+        // A refresh that could not finish: the entry is served stale as before
+        // and the next request for it tries again
+        void abandon(const std::string &key);
+
+        bool fits(size_t size) const { return size <= max_bytes; }
+};
@@ -5,6 +5,7 @@
 #include "Client.hpp"
 #include "LocationConfig.hpp"
 #include "Logger.hpp"
+#include "CgiPool.hpp"
 
 class CgiHandler {
 	public:
@@ -14,6 +15,7 @@ class CgiHandler {
 			EXECVE_FAILED,
 			PIPE_FAILED,
 			FORK_FAILED,
+			BACKEND_UNAVAILABLE,
 			TIMEOUT,
 			CGI_SCRIPT_FAILED,
 			NO_ERROR
@@ -23,9 +25,12 @@ class CgiHandler {
 		std::string interpreterPath;
 		std::map<std::string, std::string> env;
 		std::string body;
+		int body_fd;		// the request's body file, if it was spilled; not owned
 		CgiErrorType  error;
 		bool status_cgi;
 
+		int shareBodyFile() const;
+
 		public:
 		CgiHandler(const Request &req, const LocationConfig &locConfig);
 		void handleFileUpload(const std::string &body, const std::string &uploadDir);
@@ -33,7 +38,8 @@ class CgiHandler {
 		CgiErrorType getError() const { return error; };
 
 		// Non-blocking CGI execution
-		bool startCgi(Client &client);
+		bool startCgi(Client &client, CgiPool *pool);
+		bool startFastCgi(Client &client, FastCgiPool &pool, const LocationConfig &locConfig);
 		std::string finishCgi(const Client &client, int exit_status);
 
 		// Old blocking method (keep for reference)
@@ -43,5 +49,3 @@ class CgiHandler {
 		//bool saveFile(const std::string &filePath, const std::string &fileContent);
 
 };
-
-std::string getInterpreterPath(const std::string &cgiExtension);
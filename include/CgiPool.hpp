@@ -0,0 +1,74 @@
+#pragma once
+
+#include "TimerWheel.hpp"
+
+#include <sys/types.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// argv[1] that starts the server binary as a pool worker
+#define CGI_WORKER_FLAG "--cgi-worker"
+
+// Pre-spawned CGI processes, one group per interpreter. A worker is a fresh
+// exec of the server binary that closed everything it inherited and blocks on
+// a socketpair; a request hands it the CGI pipes (SCM_RIGHTS) plus the script
+// and environment, and it execve()s the interpreter in place. The server thus
+// never forks on the request path, and the CGI process is still our child, so
+// waitpid() and kill() on its pid work as for a forked one.
+//
+// Workers are single-use. Each group keeps at least `min` idle workers, grows
+// towards `max` after requests found none idle, and shrinks back once extra
+// workers sat idle for `idle_ms`. Owned by one event loop; not thread-safe.
+class CgiPool
+{
+    private:
+        struct Worker {
+            pid_t pid;
+            int sock;
+            msec_t idle_since;
+        };
+
+        struct Group {
+            size_t min;
+            size_t max;
+            int idle_ms;
+            size_t target;              // idle workers wanted right now, min..max
+            std::vector<Worker> idle;   // oldest first
+        };
+
+        std::map<std::string, Group> groups;
+        std::vector<pid_t> exited;      // retired workers not reaped yet
+
+        static std::string executable;      // path to exec, which may differ from argv[0]
+        static std::string program_name;
+
+        bool spawn(Group &group, msec_t now);
+        void retire(Worker &worker);
+
+        CgiPool(const CgiPool &);
+        CgiPool &operator=(const CgiPool &);
+
+    public:
+        CgiPool() {}
+        ~CgiPool();
+
+        static void setExecutable(const char *argv0);
+
+        // Merges with an existing group for the same interpreter, keeping the larger sizes
+        void configure(const std::string &interpreter, size_t min, size_t max, int idle_ms);
+        bool empty() const { return groups.empty(); }
+
+        // Starts `script` in `dir` on an idle worker with the given stdin,
+        // stdout and stderr; returns its pid, or -1 to fall back to fork()
+        pid_t dispatch(const std::string &interpreter, const std::string &dir, const std::string &script,
+                       const std::map<std::string, std::string> &env, const int child_fds[3]);
+
+        // Spawns, retires and reaps workers; cheap when nothing is due.
+        // Returns true while some of that is still pending.
+        bool maintain(msec_t now);
+};
+
+// Worker side, run from main() when started with CGI_WORKER_FLAG; never returns
+int runCgiWorker(int sock);
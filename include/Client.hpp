@@ -2,8 +2,16 @@
 
 #include "Response.hpp"
 #include "Request.hpp"
+#include "TimerWheel.hpp"
+#include "OutputQueue.hpp"
+#include "RequestParser.hpp"
+#include "FastCgi.hpp"
+#include "CgiCache.hpp"
+#include "MultipartUpload.hpp"
+#include "FileUpload.hpp"
 
 #include <string>
+#include <vector>
 #include <ctime>
 
 class Client {
@@ -18,6 +26,7 @@ class Client {
 
 		struct CgiContext {
 			pid_t pid;
+			int pid_fd;     // readable once the process exits; -1 if it must be polled
 			int stdin_fd;   // write to CGI
 			int stdout_fd;  // read from CGI
 			int stderr_fd;  // read CGI errors
@@ -25,28 +34,70 @@ class Client {
 			std::string output_buffer;  // data read from CGI
 			std::string error_buffer;   // errors from CGI
 			size_t input_sent;          // bytes already sent to CGI
+			int body_fd;                // request body spilled to a temp file, read into input_buffer piecewise
+			off_t body_offset;
 			time_t start_time;
 			bool stdin_closed;
 			bool stdout_closed;
 			bool stderr_closed;
+
+			// FastCGI: one socket both ways instead of the pipes and the process
+			int fcgi_fd;
+			std::string fcgi_address;
+			size_t fcgi_keepalive;      // 0: close the connection after the request
+			fcgi::ResponseDecoder fcgi_reply;
+
+			// Once the body starts, output goes to the client as it arrives
+			bool http11;                // the request allows a chunked reply
+			bool streaming;             // response head sent; output_buffer unused
+			bool chunked;               // else delimited by Content-Length or by close
+			long long stream_left;      // declared Content-Length not sent yet, -1 if none
+			bool paused;                // output not read while the client catches up
+
+			// cgi_max_concurrent: the location whose slot this holds, or waits for
+			const LocationConfig *limit_location;
+			bool queued;                // nothing started yet; the request waits below
+			msec_t queued_at;
+			Request queued_request;
+
+			// cgi_coalesce: identical requests answered by this CGI, or the one this request waits on
+			std::string flight;         // key others may still attach under; empty once closed
+			std::vector<int> followers; // client fds that get a copy of the response
+			int leader_fd;              // -1 unless another client's CGI answers this request
+
+			// cgi_cache_size: output is held whole and stored under `cache_key` if it fits
+			CgiCache *cache;
+			std::string cache_key;      // empty: not cached
+			bool refresh;               // the client got a stale copy; the run only updates the cache
 			
-			CgiContext() : pid(-1), stdin_fd(-1), stdout_fd(-1), stderr_fd(-1),
-							input_sent(0), start_time(0), stdin_closed(false),
-							stdout_closed(false), stderr_closed(false) {}
+			CgiContext() : pid(-1), pid_fd(-1), stdin_fd(-1), stdout_fd(-1), stderr_fd(-1),
+							input_sent(0), body_fd(-1), body_offset(0), start_time(0), stdin_closed(false),
+							stdout_closed(false), stderr_closed(false),
+							fcgi_fd(-1), fcgi_keepalive(0), http11(false),
+							streaming(false), chunked(false), stream_left(-1), paused(false),
+							limit_location(NULL), queued(false), queued_at(0), leader_fd(-1),
+							cache(NULL), refresh(false) {}
+
+			// Once input_buffer was sent, loads the next part of body_fd into it
+			void refillInput();
 		};
 
 	private:
 		int client_fd;
 		int server_idx;
-		std::string request_buffer;
+		std::string request_buffer;	// received bytes the parser has not consumed yet
+		RequestParser parser;
 		State current_state;
-		time_t state_start_time;
-		std::string response_buffer;
-		size_t bytes_sent;
+		OutputQueue output;
 		int port;
 		bool keep_alive;
+		bool streaming_body;	// the parser hands the body to the CGI as it arrives
+		MultipartUpload *upload;	// the parser hands the body to this as it arrives
+		FileUpload *file_upload;	// a PUT body, spliced from the socket as it arrives
         Response *res;
 		CgiContext cgi_context;
+		TimerWheel::Timer timer;	// the one pending timeout, scheduled by the event loop
+		TimerWheel::Timer cgi_deadline;	// TIMEOUT_CGI, armed once when the CGI starts
 
     public:
     	Client(int fd, int server_index);
@@ -55,25 +106,32 @@ class Client {
 
 		void appendRequestData(char* buffer, int bytes);
 		void consumeRequestBytes(size_t n) {request_buffer.erase(0, n);};
-		bool isTimedOut(int timeout_seconds) const;
 		
 		int getFd() const { return client_fd; }
-		std::string getRequest() const { return request_buffer; }
+		std::string &getPendingInput() { return request_buffer; }
+		bool hasPendingInput() const { return !request_buffer.empty(); }
+		RequestParser &getParser() { return parser; }
     	int getServerIndex() const { return server_idx; }
-    	std::string getResponse() const { return response_buffer; }
-		size_t getBytesSent() const {return bytes_sent;}
+		OutputQueue &getOutput() { return output; }
 		State getState() const { return Client::current_state; }
 		int getPort() const { return port; }
 		bool getKeepAlive() const { return keep_alive; }
+		bool isStreamingBody() const { return streaming_body; }
+		MultipartUpload *getUpload() { return upload; }
+		FileUpload *getFileUpload() { return file_upload; }
     	Response *getResponseObj() { return res; }
 		CgiContext &getCgiContext() { return cgi_context; }
 		const CgiContext &getCgiContext() const { return cgi_context; }
+		TimerWheel::Timer &getTimer() { return timer; }
+		TimerWheel::Timer &getCgiDeadline() { return cgi_deadline; }
 
     	void setState(State new_state);
 		void setKeepAlive(const Request &req);
-		void setResponseBuffer(std::string response) { response_buffer = response; }
-		void setBytesSent(size_t bytes) { bytes_sent = bytes; }
+		void queueResponse(Response &response);
 		void setPort(int p) { port = p; }
 		void setKeepAlive(bool set) {keep_alive = set;};
+		void setStreamingBody(bool set) { streaming_body = set; }
+		void setUpload(MultipartUpload *u);
+		void setFileUpload(FileUpload *u);
         void setResponseObj(Response *r) { res = r; }
 };
\ No newline at end of file
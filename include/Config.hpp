@@ -2,16 +2,29 @@
 
 #include "ServerConfig.hpp"
 #include "ServerSocket.hpp"
-#include "Client.hpp"
 #include "LocationConfig.hpp"
+#include "Request.hpp"
+#include "Response.hpp"
+#include "Poller.hpp"
+#include "FileCache.hpp"
+#include "CgiCache.hpp"
 
-#include <poll.h>
+#include <signal.h>
 
 #include <vector>
 #include <string>
 #include <iostream>
 
-const int MAX_CLIENT = 1024;
+// Set by the SIGINT/SIGTERM handler. Waits interrupted by anything else, like
+// a CGI child exiting, just resume.
+extern volatile sig_atomic_t g_stop_signal;
+void installStopHandler();
+
+// How the acceptor thread picks an event loop for a new connection
+enum ThreadDispatch {
+    DISPATCH_ROUND_ROBIN,
+    DISPATCH_LEAST_LOADED
+};
 
 struct PortState {
     bool anyTaken;
@@ -28,49 +41,43 @@ class Config
         void loadFromFile(const std::string &filepath);
         std::vector<ServerSocket> serverSockets;
 
-        int client_count;
-        std::vector<Client> clients;
-		std::vector<pollfd> poll_fds;
-
-		// Map to track what each fd represents
-		std::map<int, std::string> fd_types; // "server", "client", "cgi_stdin", "cgi_stdout", "cgi_stderr"
-		std::map<int, int> fd_to_client; // Map CGI fds to client index
+        Poller::Backend event_backend;
+        int worker_processes;
+        int worker_threads;
+        ThreadDispatch thread_dispatch;
+        std::vector<FileCache *> file_caches;
+        std::vector<CgiCache *> cgi_caches;
 
+        void createCaches();
         bool validateBindings(std::string &errorMsg) const;
-        void setupPollfdSet(int server_count);
-        bool pollLoop(int server_count);
-        void handleNewConnection(int server_fd, int server_idx);
-        void handleIdleClient(int client_idx, int pollfd_idx);
-		void handleClientRequest(int pollfd_idx, int client_idx);
-        void handleResponse(int client_idx, int pollfd_idx);
-
-        // CGI handling methods
-        void handleCgiRequest(int client_idx, const Request &reqObj, const LocationConfig &locConfig);
-        void handleCgiIO(int client_idx);
-        void handleCgiStdin(int client_idx);
-        void handleCgiStdout(int client_idx);
-        void handleCgiStderr(int client_idx);
-        void finalizeCgiExecution(int client_idx);
-        void addCgiPollFds(int client_idx);
-        void removeCgiPollFds(int client_idx);
-        void checkCgiProcesses();
-
-		void cleanup();
+        bool runThreaded();
 
         public:
         Config(const std::string &filepath);
-        Config() {};
-        Config(const Config &obj) : servers(obj.servers) {};
+        Config() : event_backend(Poller::POLL), worker_processes(1), worker_threads(1),
+                   thread_dispatch(DISPATCH_ROUND_ROBIN) {};
+        Config(const Config &obj) : servers(obj.servers), event_backend(obj.event_backend),
+                                    worker_processes(obj.worker_processes), worker_threads(obj.worker_threads),
+                                    thread_dispatch(obj.thread_dispatch) {};
         Config &operator=(const Config &other);
-        ~Config() {};
+        ~Config();
 
         const std::vector<ServerConfig> &getServers() const { return servers; };
+        Poller::Backend getEventBackend() const { return event_backend; }
+        int getWorkerProcesses() const { return worker_processes; }
+        int getWorkerThreads() const { return worker_threads; }
+        ThreadDispatch getThreadDispatch() const { return thread_dispatch; }
         void addServer(ServerConfig &server);
+        void setEventBackend(Poller::Backend b) { event_backend = b; }
+        void setWorkerProcesses(int n) { worker_processes = n; }
+        void setWorkerThreads(int n) { worker_threads = n; }
+        void setThreadDispatch(ThreadDispatch d) { thread_dispatch = d; }
         bool setupServer();
+        void closeListeners();
         bool run();
 };
 
 //std::ostream &operator<<(std::ostream &os, const Config &obj); // to print config in main
 const LocationConfig *matchLocation(const std::string &path, const ServerConfig &obj);
-std::string buildRequestAndResponse(const ServerConfig &srv, Request &outReq, const LocationConfig &loc);
+void buildRequestAndResponse(Response &res, Request &outReq, const LocationConfig &loc);
 void applyLocationConfig(Request& reqObj, const LocationConfig& loc);
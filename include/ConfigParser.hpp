@@ -2,6 +2,8 @@
 
 #include "ServerConfig.hpp"
 #include "LocationConfig.hpp"
+#include "Poller.hpp"
+#include "Config.hpp"
 #include <string>
 #include <utility>
 #include <iostream>
@@ -10,7 +12,11 @@
 #include <cstdlib>
 #include <set>
 
-class Config;
+const int MAX_WORKERS = 256;
+const long MAX_TIMEOUT_MS = 24L * 3600 * 1000;
+const size_t MAX_CGI_POOL = 256;
+const size_t MAX_CGI_CONCURRENT = 4096;
+const size_t MAX_CGI_QUEUE = 65536;
 
 class ConfigParser {
 private:
@@ -22,11 +28,18 @@ private:
     ServerConfig parseServerBlock(std::vector<std::string> lines);
     LocationConfig parseLocationBlock(std::vector<std::string> lines);
 
+    // Parsers for global directives
+    Poller::Backend parseEventBackend(const std::vector<std::string> &tokens);
+    int parseWorkerCount(const std::vector<std::string> &tokens);
+    ThreadDispatch parseThreadDispatch(const std::vector<std::string> &tokens);
+
     // Parsers for the SERVER block
     std::string parseHost(const std::vector<std::string> &tokens);
     int parsePort(const std::vector<std::string> &tokens);
     std::pair<int, std::string> parseErrorPageLine(const std::vector<std::string> &tokens);
-    size_t parseMaxBodySize(const std::vector<std::string> &tokens);
+    size_t parseSize(const std::vector<std::string> &tokens);
+    std::string parseTempPath(const std::vector<std::string> &tokens);
+    int parseTimeout(const std::vector<std::string> &tokens);
 
     // Parsers for the LOCATION block
     std::string parsePath(const std::vector<std::string> &tokens);
@@ -36,7 +49,12 @@ private:
     std::pair<int, std::string> parseRedirection(const std::vector<std::string> &tokens);
     std::string parseUploadDir(const std::vector<std::string> &tokens);
     bool parseAutoindex(const std::vector<std::string> &tokens);
+    bool parseOnOff(const std::vector<std::string> &tokens);
+	void checkCgiExtension(const std::string &extension);
 	std::string parseCgiExtension(const std::vector<std::string> &tokens);
+	std::pair<std::string, std::string> parseCgiInterpreter(const std::vector<std::string> &tokens);
+	std::string parseFastCgiPass(const std::vector<std::string> &tokens);
+	size_t parseCount(const std::vector<std::string> &tokens, size_t limit);
 
 public:
     Config  parseConfigFile(const std::string &filename);
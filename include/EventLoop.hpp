@@ -0,0 +1,193 @@
+#pragma once
+
+#include "ServerConfig.hpp"
+#include "Client.hpp"
+#include "LocationConfig.hpp"
+#include "Poller.hpp"
+#include "HttpException.hpp"
+#include "TimerWheel.hpp"
+#include "CgiPool.hpp"
+
+#include <pthread.h>
+
+#include <deque>
+#include <map>
+#include <vector>
+#include <string>
+
+const int MAX_CLIENT = 1024;
+
+// Pipelined requests are answered ahead only while the client's queued output
+// stays under these; each file segment holds an open fd
+const size_t PIPELINE_MAX_BYTES = 256 * 1024;
+const size_t PIPELINE_MAX_SEGMENTS = 64;
+
+// CGI output queued for a slow client beyond this stops reads from the script
+// until half of it has been sent
+const size_t CGI_STREAM_HIGH_WATER = 64 * 1024;
+
+// Request body bytes waiting for a CGI's stdin beyond this stop reads from the client
+const size_t CGI_BODY_HIGH_WATER = 64 * 1024;
+
+// Most PUT body bytes spliced from one client per readiness event, for fairness
+const size_t UPLOAD_SPLICE_BUDGET = 4 * 1024 * 1024;
+
+// Poll interval while a CGI without a pidfd has closed its output but has not
+// been reaped yet
+const int CGI_REAP_POLL_MS = 10;
+
+// What an fd registered with the event loop is used for
+enum FdRole {
+    FD_NONE,
+    FD_SERVER,
+    FD_CLIENT,
+    FD_CGI_STDIN,
+    FD_CGI_STDOUT,
+    FD_CGI_STDERR,
+    FD_CGI_EXIT,
+    FD_FASTCGI,
+    FD_WAKEUP
+};
+
+// Connection table entry, indexed by fd. `slot` is the server index for
+// FD_SERVER and the owning client's slot in `clients` otherwise.
+struct FdEntry {
+    FdRole role;
+    int slot;
+
+    FdEntry() : role(FD_NONE), slot(-1) {}
+};
+
+// A connection accepted by another thread, waiting to be adopted by a loop
+struct PendingConnection {
+    int fd;
+    int server_idx;
+    int port;
+};
+
+// CGI requests of a location with cgi_max_concurrent: how many run, and the
+// client fds waiting for one of them to finish, oldest first
+struct CgiAdmission {
+    size_t running;
+    std::deque<int> waiting;
+
+    CgiAdmission() : running(0) {}
+};
+
+// One reactor: a poller plus every connection and CGI pipe it owns. The
+// server configuration is shared read-only between loops.
+class EventLoop
+{
+    private:
+        const std::vector<ServerConfig> &servers;
+        Poller::Backend backend;
+        Poller poller;
+
+        int client_count;
+        std::vector<Client *> clients;  // dense; removal swaps the last client in
+        std::vector<FdEntry> fd_table;  // fd -> role and client slot
+        int cgi_polled;                 // CGI processes without a pidfd, found by polling waitpid()
+        FastCgiPool fastcgi_pool;
+        CgiPool cgi_pool;
+
+        // cgi_max_concurrent and cgi_queue_size are enforced per loop, like the pools
+        std::map<const LocationConfig *, CgiAdmission> cgi_admission;
+        bool cgi_slots_freed;           // queued requests may be startable
+        std::map<std::string, int> cgi_flights;     // cgi_coalesce key -> client fd running it
+
+        // Timeouts; timers are owned by client fds, `now_ms` is refreshed once per wakeup
+        TimerWheel timers;
+        msec_t now_ms;
+        std::vector<TimerEvent> fired;
+
+        // Cross-thread handoff, guarded by `lock`
+        pthread_mutex_t lock;
+        int wake_pipe[2];
+        std::vector<PendingConnection> pending;
+        int load;
+        bool stop_requested;
+
+        void handleNewConnection(int server_fd, int server_idx);
+        void adoptClient(int client_fd, int server_idx, int port);
+        void drainWakeup();
+        void handleIdleClient(int client_idx);
+		void handleClientRequest(int client_idx);
+        void processPipeline(int client_idx);
+        void scheduleClient(int client_idx);
+        void handleResponse(int client_idx);
+        void acceptBody(int client_idx);
+        void startUpload(int client_idx);
+        void feedUpload(int client_idx);
+        void startFileUpload(int client_idx);
+        void spliceFileUpload(int client_idx);
+        void finishFileUpload(int client_idx);
+        void closeClient(int client_idx);
+        void trackFd(int fd, FdRole role, int slot);
+        void untrackFd(int fd);
+        const FdEntry &lookupFd(int fd) const;
+        void retargetClientFds(int slot);
+        void sendErrorResponse(int client_idx, const HttpException &e);
+        void queueErrorResponse(int client_idx, const HttpException &e);
+        void armTimer(int client_idx, TimeoutKind kind);
+        void armTimer(int client_idx, TimerWheel::Timer &timer, TimeoutKind kind);
+        void runTimers();
+        void handleTimeout(int client_idx, TimeoutKind kind);
+        void setLoad(int n);
+
+        // CGI handling methods
+        void handleCgiRequest(int client_idx, const Request &reqObj, const LocationConfig &locConfig);
+        void launchCgi(int client_idx, const Request &reqObj, const LocationConfig &locConfig);
+        bool cgiSlotFree(const LocationConfig &locConfig);
+        void admitQueuedCgis();
+        void queueCgiBusy(int client_idx, const std::string &reason);
+        void queueCgiResult(int client_idx, Response &res);
+        bool serveCachedCgi(int client_idx, const Request &reqObj, const LocationConfig &locConfig);
+        void cacheCgiOutput(Client &client);
+        bool joinCgiFlight(int client_idx, const std::string &flight, const Request &reqObj);
+        void closeCgiFlight(Client &client);
+        void shareCgiResponse(int client_idx, Response &res);
+        void handOverCgi(int client_idx);
+        int cgiLeader(int client_idx);
+        size_t cgiBacklog(int client_idx);
+        void startCgiEarly(int client_idx);
+        void feedCgiBody(int client_idx);
+        void handleCgiTimeout(int client_idx);
+        void handleCgiStdin(int client_idx);
+        void handleCgiStdout(int client_idx);
+        void handleCgiStderr(int client_idx);
+        void finalizeCgiExecution(int client_idx);
+        void finishCgiResponse(int client_idx, Response &res);
+        void relayCgiOutput(int client_idx, const char *data, size_t len);
+        void startCgiStream(int client_idx);
+        bool beginCgiStream(Client &client, const std::string &output);
+        void streamCgiBody(int client_idx, const char *data, size_t len);
+        void pushCgiBody(Client &client, const char *data, size_t len);
+        void pauseCgiOutput(int client_idx, bool pause);
+        void endCgiStream(int client_idx, bool ok);
+        void handleFastCgi(int client_idx, short revents);
+        void completeFastCgi(int client_idx);
+        void failFastCgi(int client_idx, const std::string &reason);
+        void addCgiPollFds(int client_idx);
+        void removeCgiPollFds(int client_idx);
+        void closeCgiFd(int client_idx, int fd);
+        bool reapCgi(int client_idx);
+        bool checkCgiProcesses();
+
+		void cleanup();
+
+        EventLoop(const EventLoop &);
+        EventLoop &operator=(const EventLoop &);
+
+    public:
+        EventLoop(const std::vector<ServerConfig> &servers, Poller::Backend backend);
+        ~EventLoop();
+
+        bool init();
+        bool addListener(int fd, int server_idx);
+        bool run();
+
+        // Thread-safe: called by the acceptor and the main thread
+        void enqueueConnection(int fd, int server_idx, int port);
+        void stop();
+        int getLoad();
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+// Client side of FastCGI 1.0 in the responder role: encoding a request and
+// decoding the backend's reply. A backend connection carries one request at a
+// time, so the request id is always 1.
+namespace fcgi {
+
+    enum RecordType {
+        BEGIN_REQUEST = 1,
+        ABORT_REQUEST = 2,
+        END_REQUEST = 3,
+        PARAMS = 4,
+        STDIN = 5,
+        STDOUT = 6,
+        STDERR = 7
+    };
+
+    enum ProtocolStatus {
+        REQUEST_COMPLETE = 0,
+        CANT_MPX_CONN = 1,
+        OVERLOADED = 2,
+        UNKNOWN_ROLE = 3
+    };
+
+    // Appends the whole request: BEGIN_REQUEST, then the PARAMS and STDIN
+    // streams, each closed by an empty record
+    void encodeRequest(std::string &out, const std::map<std::string, std::string> &params,
+                       const std::string &body, bool keep_conn);
+    // The same in pieces, for a body read from a file: BEGIN_REQUEST and
+    // PARAMS first, then STDIN records as the body is read; len 0 ends it
+    void encodeBegin(std::string &out, const std::map<std::string, std::string> &params, bool keep_conn);
+    void encodeStdin(std::string &out, const char *data, size_t len);
+
+    // Reassembles records from the bytes read so far; stdout and stderr
+    // content is appended to the caller's buffers as it arrives
+    class ResponseDecoder
+    {
+        private:
+            std::string pending;        // incomplete record
+            bool ended;
+            int protocol_status;
+
+        public:
+            ResponseDecoder() : ended(false), protocol_status(REQUEST_COMPLETE) {}
+
+            // Returns false if the stream is not FastCGI
+            bool feed(const char *data, size_t len, std::string &out, std::string &err);
+
+            bool done() const { return ended; }
+            int getProtocolStatus() const { return protocol_status; }
+            bool hasExtraBytes() const { return !pending.empty(); }
+    };
+
+    // Canonical form of a fastcgi_pass address, "unix:/path" or "ip:port",
+    // with host names resolved; empty if invalid
+    std::string resolveAddress(const std::string &address);
+
+    // Non-blocking socket to a resolved address; the connect may still be in
+    // progress, a failure then shows up on the first write. -1 on error.
+    int connectBackend(const std::string &address);
+}
+
+// Keep-alive connections to FastCGI backends that are waiting for their next
+// request. Each event loop has its own, so there is no locking.
+class FastCgiPool
+{
+    private:
+        std::map<std::string, std::vector<int> > idle;
+
+        FastCgiPool(const FastCgiPool &);
+        FastCgiPool &operator=(const FastCgiPool &);
+
+    public:
+        FastCgiPool() {}
+        ~FastCgiPool();
+
+        // An idle connection that is still open, else a new one; -1 on failure
+        int acquire(const std::string &address);
+        // Keeps `fd` for reuse unless `max_idle` connections to `address` already wait
+        void release(const std::string &address, int fd, size_t max_idle);
+};
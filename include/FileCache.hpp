@@ -0,0 +1,55 @@
+#pragma once
+
+#include "TimerWheel.hpp"
+
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <list>
+#include <map>
+#include <string>
+
+// Size-bounded LRU cache of small static files for one location. Entries are
+// keyed by the path of the file they were read from, which is re-stat()ed at
+// most once per `valid_ms` to catch changes to its content or permissions.
+// Shared by all event loop threads of a process.
+class FileCache
+{
+    private:
+        struct Entry {
+            std::string key;
+            std::string body;
+            std::string content_type;
+            mode_t mode;
+            time_t mtime;
+            off_t size;
+            msec_t validated_at;
+        };
+        typedef std::list<Entry> EntryList;
+
+        size_t max_bytes;
+        size_t max_entry;
+        int valid_ms;
+
+        pthread_mutex_t lock;
+        EntryList lru;                  // most recently used first
+        std::map<std::string, EntryList::iterator> index;
+        size_t bytes;
+
+        void erase(EntryList::iterator it);
+
+        FileCache(const FileCache &);
+        FileCache &operator=(const FileCache &);
+
+    public:
+        FileCache(size_t max_bytes, size_t max_entry, int valid_ms);
+        ~FileCache();
+
+        // Copies the cached body on a hit
+        bool lookup(const std::string &key, std::string &body, std::string &content_type);
+        void insert(const std::string &key, const struct stat &st,
+                    const std::string &body, const std::string &content_type);
+
+        bool fits(off_t size) const { return size >= 0 && (size_t)size <= max_entry && (size_t)size <= max_bytes; }
+};
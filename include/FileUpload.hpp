@@ -0,0 +1,46 @@
+#pragma once
+
+#include "LocationConfig.hpp"
+#include "Request.hpp"
+
+#include <sys/types.h>
+#include <string>
+
+// A PUT body written to one file of an upload location. On Linux the bytes
+// go from the socket, or the request's temp file, into a pipe and from there
+// into the file with splice(), so the payload is never copied into userspace.
+// The file is written under a temp name next to its target and renamed by
+// finish(), so an interrupted upload leaves nothing behind.
+class FileUpload
+{
+    private:
+        static const size_t PIPE_SIZE = 1 << 20;
+
+        std::string path;
+        std::string temp;
+        int fd;
+        int pipe_fds[2];
+        size_t pipe_size;           // what one splice() into the pipe may move
+        bool done;
+
+        void writeFile(const char *data, size_t len);
+        void drainPipe(size_t len);
+
+        FileUpload(const FileUpload &);
+        FileUpload &operator=(const FileUpload &);
+
+    public:
+        // The file is named after the request path below the location's URI;
+        // creates the location's upload_path if needed
+        FileUpload(const LocationConfig &loc, const std::string &req_path);
+        ~FileUpload();
+
+        // Moves up to `len` bytes from `in`, read at `*offset` unless it is
+        // NULL. Returns the count, 0 at end of input, or -1 with errno set if
+        // `in` had nothing yet (EAGAIN) or failed. Failing to write throws 500.
+        ssize_t transfer(int in, off_t *offset, size_t len);
+        // Writes what `req` holds of its body, in memory or in its temp file
+        void processBody(const Request &req);
+        // Moves the file into place; true if it did not exist before
+        bool finish();
+};
@@ -15,12 +15,14 @@ public:
 
     const std::string *findHeader(const std::string &key) const;
 
-    const std::map<std::string, std::string> getHeaders() const { return headers_; };
-    const std::string getBody() const { return body_; };
+    const std::map<std::string, std::string> &getHeaders() const { return headers_; };
+    const std::string &getBody() const { return body_; };
     const std::string getVersion() const { return version_; };
 
     void setHeader(std::string key, std::string value);
     void setBody(const std::string &bodyToSet) { body_ = bodyToSet; };
+    void appendBody(const char *data, size_t len) { body_.append(data, len); };
+    void swapBody(std::string &other) { body_.swap(other); };
     void setVersion(const std::string &versionToSet) { version_ = versionToSet; };
 };
 
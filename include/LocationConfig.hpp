@@ -2,7 +2,12 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include <iostream>
+#include <cstddef>
+
+class FileCache;
+class CgiCache;
 
 class LocationConfig
 {
@@ -17,13 +22,31 @@ private:
     std::string upload_dir;
     bool autoindex;
     std::string cgi_extension;
+    std::map<std::string, std::string> cgi_interpreters;   // extension -> resolved interpreter path
+    std::string fastcgi_pass;       // resolved backend address; empty: no FastCGI
+    size_t fastcgi_keepalive;       // idle backend connections kept per event loop
+    size_t cgi_pool_min;            // pre-spawned CGI workers per event loop; max 0: no pool
+    size_t cgi_pool_max;
+    int cgi_pool_idle_ms;
+    size_t cgi_max_concurrent;      // running CGIs per event loop; 0: unlimited
+    size_t cgi_queue_size;          // requests waiting beyond that limit before 503s
+    bool cgi_coalesce;              // identical GETs share one running CGI
+    size_t cgi_cache_size;          // 0: no cache
+    int cgi_cache_valid_ms;         // lifetime when the script sets none
+    int cgi_cache_stale_ms;         // served stale while refreshed, unless the script says otherwise
+    CgiCache *cgi_cache;            // owned by Config
     int client_max_body_size;
+    size_t file_cache_size;         // 0: no cache
+    size_t file_cache_max_entry;
+    int file_cache_valid_ms;
+    FileCache *file_cache;          // owned by Config
+    bool stub_status;
 
 public:
     LocationConfig();
 
     //methods
-    bool isCgiRequest(std::string &uri);
+    const std::string *findCgiInterpreter(const std::string &path) const;
     bool isMethodAllowed(const std::string &method) const;
 
     //getters
@@ -36,7 +59,25 @@ public:
     const std::string &getUploadDir() const { return upload_dir; };
     const bool &getAutoindex() const { return autoindex; };
     const std::string &getCgiExtension() const { return cgi_extension; };
+    const std::map<std::string, std::string> &getCgiInterpreters() const { return cgi_interpreters; };
+    const std::string &getFastCgiPass() const { return fastcgi_pass; }
+    size_t getFastCgiKeepalive() const { return fastcgi_keepalive; }
+    size_t getCgiPoolMin() const { return cgi_pool_min; }
+    size_t getCgiPoolMax() const { return cgi_pool_max; }
+    int getCgiPoolIdle() const { return cgi_pool_idle_ms; }
+    size_t getCgiMaxConcurrent() const { return cgi_max_concurrent; }
+    size_t getCgiQueueSize() const { return cgi_queue_size; }
+    bool getCgiCoalesce() const { return cgi_coalesce; }
+    size_t getCgiCacheSize() const { return cgi_cache_size; }
+    int getCgiCacheValid() const { return cgi_cache_valid_ms; }
+    int getCgiCacheStale() const { return cgi_cache_stale_ms; }
+    CgiCache *getCgiCache() const { return cgi_cache; }
     int getMaxBodySize() const { return client_max_body_size; }
+    size_t getFileCacheSize() const { return file_cache_size; }
+    size_t getFileCacheMaxEntry() const { return file_cache_max_entry; }
+    int getFileCacheValid() const { return file_cache_valid_ms; }
+    FileCache *getFileCache() const { return file_cache; }
+    bool getStubStatus() const { return stub_status; }
 
     //setters
     void setUri(std::string set) { uri = set; };
@@ -47,7 +88,25 @@ public:
     void setUploadDir(std::string set) { upload_dir = set; };
     void setAutoindex(bool set) { autoindex = set; };
 	void setCgiExtension(std::string set) { cgi_extension = set; };
+    void setCgiInterpreter(const std::string &ext, const std::string &path) { cgi_interpreters[ext] = path; };
+    void setFastCgiPass(const std::string &set) { fastcgi_pass = set; };
+    void setFastCgiKeepalive(size_t set) { fastcgi_keepalive = set; };
+    void setCgiPoolMin(size_t set) { cgi_pool_min = set; };
+    void setCgiPoolMax(size_t set) { cgi_pool_max = set; };
+    void setCgiPoolIdle(int set) { cgi_pool_idle_ms = set; };
+    void setCgiMaxConcurrent(size_t set) { cgi_max_concurrent = set; };
+    void setCgiQueueSize(size_t set) { cgi_queue_size = set; };
+    void setCgiCoalesce(bool set) { cgi_coalesce = set; };
+    void setCgiCacheSize(size_t set) { cgi_cache_size = set; };
+    void setCgiCacheValid(int set) { cgi_cache_valid_ms = set; };
+    void setCgiCacheStale(int set) { cgi_cache_stale_ms = set; };
+    void setCgiCache(CgiCache *set) { cgi_cache = set; };
     void setMaxBodySize(int set) { client_max_body_size = set; };
+    void setFileCacheSize(size_t set) { file_cache_size = set; };
+    void setFileCacheMaxEntry(size_t set) { file_cache_max_entry = set; };
+    void setFileCacheValid(int set) { file_cache_valid_ms = set; };
+    void setFileCache(FileCache *set) { file_cache = set; };
+    void setStubStatus(bool set) { stub_status = set; };
 };
 
 std::ostream &operator<<(std::ostream &os, const std::vector<LocationConfig> &obj);
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Config.hpp"
+
+#include <sys/types.h>
+#include <ctime>
+#include <map>
+
+// Supervises worker_processes forked workers. Every worker binds its own
+// SO_REUSEPORT listeners and runs a full event loop; the master only
+// restarts workers that die and forwards shutdown signals.
+class Master
+{
+    private:
+        Config &config;
+        std::map<pid_t, time_t> workers; // pid -> start time
+
+        bool spawnWorker();
+        void stopWorkers();
+
+        Master(const Master &);
+        Master &operator=(const Master &);
+
+    public:
+        explicit Master(Config &config);
+
+        bool run();
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "LocationConfig.hpp"
+#include "Request.hpp"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Incremental multipart/form-data reader for uploads (RFC 7578). Body bytes
+// are appended to input() as they arrive; process() delimits what it can and
+// writes file parts straight to temp files in the upload directory, keeping
+// only a boundary's worth of bytes plus one write back. finish() renames the
+// files into place once the closing delimiter was seen, so a failed request
+// leaves nothing behind. Parts without a filename, i.e. plain form fields, are
+// skipped. Malformed input throws HttpException.
+class MultipartUpload
+{
+    private:
+        enum State {
+            PREAMBLE,
+            DELIMITER_END,      // "--" closes the body, CRLF starts a part
+            PART_HEADERS,
+            PART_BODY,
+            EPILOGUE
+        };
+
+        static const size_t MAX_PART_HEADERS = 8192;
+        static const size_t WRITE_SIZE = 65536;
+
+        std::string dir;
+        std::string delimiter;      // CRLF, "--" and the boundary
+        size_t max_body;
+        size_t received;
+        State state;
+        std::string input_;
+        size_t kept;                // input_ bytes left over by the last process()
+        size_t scanned;             // input_ bytes known not to start a delimiter
+
+        int fd;                     // temp file of the current part, -1 while skipping it
+        std::vector<std::pair<std::string, std::string> > files;  // temp path, final path
+
+        void startPart(const std::string &headers);
+        void writePart(size_t len);
+        void endPart();
+
+        MultipartUpload(const MultipartUpload &);
+        MultipartUpload &operator=(const MultipartUpload &);
+
+    public:
+        // Takes the boundary from the request's Content-Type and creates the
+        // location's upload_path if needed
+        MultipartUpload(const LocationConfig &loc, const std::string *content_type);
+        ~MultipartUpload();
+
+        // Where the request body goes; consumed by process()
+        std::string &input() { return input_; }
+        void process();
+        // Processes what `req` holds of its body, in memory or in its temp file
+        void processBody(const Request &req);
+        // Checks the body was complete and moves the files into place
+        void finish();
+};
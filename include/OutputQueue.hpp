@@ -0,0 +1,54 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <deque>
+#include <string>
+
+// Bytes waiting to go out on a connection, as a queue of segments: in-memory
+// data (status line and headers, small bodies) or a range of an open file.
+// Only the memory segments hold their bytes; files are streamed with
+// sendfile(), so a connection's memory does not grow with the response size.
+class OutputQueue
+{
+    private:
+        struct Segment {
+            std::string data;
+            size_t pos;         // memory: bytes of `data` already sent
+            int fd;             // file: -1 for memory segments; owned by the queue
+            off_t offset;
+            off_t end;
+
+            Segment() : pos(0), fd(-1), offset(0), end(0) {}
+        };
+
+        std::deque<Segment> segments;
+        size_t memory_bytes;
+
+        void popFront();
+        ssize_t writeMemory(int sock);
+        ssize_t writeFile(int sock, size_t budget);
+
+        OutputQueue(const OutputQueue &);
+        OutputQueue &operator=(const OutputQueue &);
+
+    public:
+        static const size_t FLUSH_BUDGET = 1 << 20; // bytes per flush(), for fairness between clients
+
+        OutputQueue();
+        ~OutputQueue();
+
+        // Takes the contents of `data`, leaving it empty
+        void pushData(std::string &data);
+        // Takes ownership of `fd`; sends [offset, offset + length)
+        void pushFile(int fd, off_t offset, off_t length);
+        void clear();
+
+        // Writes as much as the socket accepts, up to FLUSH_BUDGET. Returns the
+        // byte count, or -1 with errno set (EAGAIN only if nothing was written).
+        ssize_t flush(int sock);
+
+        bool empty() const { return segments.empty(); }
+        size_t bufferedBytes() const { return memory_bytes; }
+        size_t segmentCount() const { return segments.size(); }
+};
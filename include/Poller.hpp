@@ -0,0 +1,50 @@
+#pragma once
+
+#include <poll.h>
+
+#include <vector>
+#include <string>
+
+struct PollEvent {
+    int fd;
+    short revents;
+};
+
+// Readiness notification over either poll() or epoll. Events and revents use
+// the poll.h flags (POLLIN, POLLOUT, POLLERR, POLLHUP, POLLNVAL) for both backends.
+class Poller
+{
+    public:
+        enum Backend {
+            POLL,
+            EPOLL
+        };
+
+    private:
+        Backend backend;
+        int epoll_fd;
+        size_t fd_count;
+
+        // poll backend: dense pollfd array plus fd -> position index
+        std::vector<pollfd> poll_fds;
+        std::vector<int> fd_index;
+
+        Poller(const Poller &);
+        Poller &operator=(const Poller &);
+
+    public:
+        Poller();
+        ~Poller();
+
+        bool init(Backend b);
+        bool add(int fd, short events);
+        bool modify(int fd, short events);
+        void remove(int fd);
+        int wait(int timeout_ms, std::vector<PollEvent> &ready);
+
+        Backend getBackend() const { return backend; }
+        size_t size() const { return fd_count; }
+};
+
+bool parseBackendName(const std::string &name, Poller::Backend &out);
+const char *backendName(Poller::Backend b);
@@ -7,6 +7,9 @@
 #include "HttpMessage.hpp"
 #include <algorithm>
 
+class MultipartUpload;
+class FileUpload;
+
 class Request : public HttpMessage
 {
 private:
@@ -16,15 +19,13 @@ private:
     std::string queryString_;
     int maxBodySize_;
     bool isCgi_;
-
-    bool parseRequestLine(std::string &raw);
-    bool parseHeaders(std::string &raw);
-    bool parseBody(std::string &raw);
-    void parseRequest(const std::string &raw);
+    MultipartUpload *upload_;   // set when the body was written out as it arrived
+    FileUpload *fileUpload_;    // the same for a PUT body
+    int bodyFd_;                // unlinked temp file holding the body instead of body_; not owned
+    size_t bodyFileSize_;
 
 public :
     Request();
-    explicit Request(const std::string &raw);
 
     //---getters
     int getMaxBodySize() const { return maxBodySize_; } 
@@ -34,6 +35,10 @@ public :
     const std::string getVersion() const { return version_; }
     const std::string getQueryString() const { return queryString_; }
     bool isCgi() const { return isCgi_; }
+    MultipartUpload *getUpload() const { return upload_; }
+    FileUpload *getFileUpload() const { return fileUpload_; }
+    int getBodyFd() const { return bodyFd_; }
+    size_t getBodySize() const { return bodyFd_ >= 0 ? bodyFileSize_ : body_.size(); }
 
     //---setters
     void setMethod(const std::string &m) { method_ = m; }
@@ -42,6 +47,9 @@ public :
     void setQueryString(const std::string &q) { queryString_ = q; }
     void setIsCgi(bool cgi) { isCgi_ = cgi; }
     void setMaxBodySize(int maxsize)  { maxBodySize_ = maxsize; }
+    void setUpload(MultipartUpload *upload) { upload_ = upload; }
+    void setFileUpload(FileUpload *upload) { fileUpload_ = upload; }
+    void setBodyFile(int fd, size_t size) { bodyFd_ = fd; bodyFileSize_ = size; }
 };
 
 std::ostream &operator<<(std::ostream &out, const Request &obj);
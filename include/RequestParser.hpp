@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Request.hpp"
+
+#include <string>
+#include <cstddef>
+
+// Resumable HTTP/1.x request parser. Bytes are fed as they arrive; the parser
+// keeps its state and the partial line between calls, so every byte is looked
+// at once no matter how the request is split across reads. Stops at the end
+// of a request, leaving any pipelined bytes to the caller, and after the
+// headers of one with a body until the caller accepts it. Malformed input
+// throws HttpException.
+class RequestParser
+{
+    public:
+        enum State {
+            REQUEST_LINE,
+            HEADER_LINE,
+            BODY,               // Content-Length body
+            CHUNK_SIZE,
+            CHUNK_DATA,
+            CHUNK_DATA_END,     // CRLF after a chunk's payload
+            CHUNK_TRAILER,
+            COMPLETE
+        };
+
+        static const size_t MAX_REQUEST_LINE = 16384;
+        static const size_t MAX_HEADER_BYTES = 32768;
+
+    private:
+        State state;
+        Request request;
+        std::string line;           // current line, without its terminator once complete
+        size_t header_bytes;
+        size_t body_limit;
+        size_t body_received;
+        size_t remaining;           // of the Content-Length body or the current chunk
+        std::string *body_sink;     // when set, body bytes go here instead of the Request
+        size_t body_buffer;         // larger bodies go to a temp file; 0: never
+        std::string temp_path;
+        int body_fd;                // temp file of this body or of the last one taken
+        bool body_accepted;
+
+        void spillBody(const char *data, size_t len);
+        void closeBodyFile();
+
+        void handleLine();
+        void parseRequestLine();
+        void parseHeaderLine();
+        void finishHeaders();
+        void parseChunkSize();
+
+        RequestParser(const RequestParser &);
+        RequestParser &operator=(const RequestParser &);
+
+    public:
+        RequestParser();
+        ~RequestParser();
+
+        // Consumes bytes up to the end of the current request; returns how many
+        size_t feed(const char *data, size_t len);
+
+        // Moves the finished request out and starts over
+        void take(Request &out);
+        void reset();
+
+        // Lets feed() read the body, now limited to `limit` bytes (0: none);
+        // a Content-Length beyond it throws 413 without reading any of it
+        void acceptBody(size_t limit);
+        // Content-Length body bytes the caller took from the socket itself
+        void skipBody(size_t len);
+        size_t bodyRemaining() const { return state == BODY ? remaining : 0; }
+        // Until reset(), the rest of the body is appended to `sink`
+        void setBodySink(std::string *sink) { body_sink = sink; }
+        // Bodies beyond `size` are written to an unlinked file in `path` as
+        // they arrive; the Request then refers to it until the next request
+        void setBodyBuffer(size_t size, const std::string &path) { body_buffer = size; temp_path = path; }
+
+        // The request so far, e.g. to route it once its headers are in
+        const Request &current() const { return request; }
+
+        State getState() const { return state; }
+        bool idle() const { return state == REQUEST_LINE && line.empty() && header_bytes == 0; }
+        bool complete() const { return state == COMPLETE; }
+        bool headersDone() const { return state != REQUEST_LINE && state != HEADER_LINE; }
+        // Headers are in and the body waits for acceptBody()
+        bool awaitingBody() const { return headersDone() && state != COMPLETE && !body_accepted; }
+};
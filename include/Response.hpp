@@ -1,12 +1,14 @@
 #pragma once
 
 #include <string>
+#include <sys/types.h>
 #include "HttpMessage.hpp"
 #include "Logger.hpp"
 
 
 class Config;
 class Request;
+class OutputQueue;
 class LocationConfig;
 
 class Response : public HttpMessage
@@ -21,6 +23,8 @@ private:
     std::string filename_;
     std::string contentType_;
     std::map<int, std::string> error_pages_config;
+    int bodyFd_;            // file-backed body, sent after the headers with sendfile()
+    off_t bodyFileSize_;
 
     void generateAutoIndex(void);
     void handleGet(const LocationConfig &loc);
@@ -29,18 +33,24 @@ private:
     void handleRedirect(const LocationConfig &locConfig);
 
     void handlePost(const Request &reqObj, LocationConfig loc);
+    void handlePut(const Request &reqObj, const LocationConfig &loc);
     void uploadFile(const std::string &uploadFullPath);
     void readFileIntoBody(const std::string &fileName);
+    void openBodyFile(const std::string &fileName, off_t size);
     std::string generateDefaultPage(const int code, const std::string &message, bool error) const;
 
+    Response(const Response &);
+    Response &operator=(const Response &);
 
 public:
     Response();
     Response(std::map<int, std::string> error_pages_config);
     Response(std::map<int, std::string> error_pages_config, int code, const std::string &message, bool error);
+    ~Response();
 
-    std::string writeResponseString() const;
-    std::string buildResponse(const Request &reqObj, const LocationConfig &Config);
+    std::string writeHeaders() const;
+    void queueInto(OutputQueue &out);
+    void buildResponse(const Request &reqObj, const LocationConfig &Config);
 
     int getCode() const { return statusCode_; }
     const std::string getStatusMessage() const { return statusMessage_; }
@@ -52,5 +62,6 @@ public:
     void setCode(const int code);
     void setPage(const int code, const std::string &message, bool error);
 
+    size_t parseCgiHeaders(const std::string &cgiOutput);
     void parseCgiResponse(const std::string &cgiOutput);
 };
\ No newline at end of file
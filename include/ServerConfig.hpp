@@ -7,6 +7,20 @@
 
 #include "LocationConfig.hpp"
 
+// Per-server timeouts enforced by the event loop's timer wheel
+enum TimeoutKind {
+    TIMEOUT_HEADER,     // whole request head must arrive within this
+    TIMEOUT_BODY,       // between two reads of the request body
+    TIMEOUT_SEND,       // between two writes of the response
+    TIMEOUT_KEEPALIVE,  // idle keep-alive connection
+    TIMEOUT_CGI,        // CGI process run time, counted once from its start
+    TIMEOUT_CGI_IDLE,   // CGI silence: no output read and no body written
+    TIMEOUT_CGI_QUEUE,  // wait for a CGI slot under cgi_max_concurrent
+    TIMEOUT_KINDS
+};
+
+const char *timeoutDirective(TimeoutKind kind);
+
 class ServerConfig
 {
 private:
@@ -14,7 +28,10 @@ private:
     std::string host;
     std::map<int, std::string> error_pages_config;
     int client_max_body_size;
+    size_t client_body_buffer_size;     // request bodies beyond this are spilled to a temp file
+    std::string client_body_temp_path;
     std::vector<LocationConfig> locations;
+    int timeouts_ms[TIMEOUT_KINDS];
 
 public:
     ServerConfig();
@@ -24,13 +41,20 @@ public:
     const std::map<int, std::string> &getErrorPagesConfig() const { return error_pages_config; }
     const std::string &getErrorPage (int code) const;
     int getMaxBodySize() const { return client_max_body_size; }
+    size_t getBodyBufferSize() const { return client_body_buffer_size; }
+    const std::string &getBodyTempPath() const { return client_body_temp_path; }
     const std::vector<LocationConfig> &getLocations() const { return locations; }
+    std::vector<LocationConfig> &getLocations() { return locations; }
+    int getTimeout(TimeoutKind kind) const { return timeouts_ms[kind]; }
 
     void setHost(std::string set) { host = set; };
     void setPort(int set) { listen_port = set; };
     void setErrorPagesConfig(std::pair<int, std::string> set) { error_pages_config[set.first] = set.second; };
     void setMaxBodySize(int set) { client_max_body_size = set; };
+    void setBodyBufferSize(size_t set) { client_body_buffer_size = set; };
+    void setBodyTempPath(const std::string &set) { client_body_temp_path = set; };
     void addLocation(LocationConfig &locConfig) { locations.push_back(locConfig); };
+    void setTimeout(TimeoutKind kind, int ms) { timeouts_ms[kind] = ms; };
 };
 
 std::ostream &operator<<(std::ostream &os, const ServerConfig &obj);
@@ -10,6 +10,7 @@ class ServerSocket {
 		int port;
 		std::string host;
 		bool isSetup;
+		bool reusePort;
 		
 		bool createSocket();
 		bool configureSocket();
@@ -20,7 +21,8 @@ class ServerSocket {
 		ServerSocket();
 		~ServerSocket();
 
-		bool setupServerSocket(int port, std::string host);
+		bool setupServerSocket(int port, std::string host, bool reusePort = false);
+		void closeSocket();
 
 		int getFd() const {return fd;}
 		std::string getHost() const {return host;}
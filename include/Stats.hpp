@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+// Process-wide counters, safe to bump from any event loop thread and
+// reported by locations with `stub_status on`
+enum StatCounter {
+    STAT_FILE_CACHE_HITS,
+    STAT_FILE_CACHE_MISSES,
+    STAT_FILE_CACHE_EVICTIONS,
+    STAT_FILE_CACHE_ENTRIES,    // gauge
+    STAT_FILE_CACHE_BYTES,      // gauge
+    STAT_CGI_POOL_HITS,
+    STAT_CGI_POOL_MISSES,
+    STAT_CGI_POOL_IDLE,         // gauge
+    STAT_CGI_QUEUE_DEPTH,       // gauge: requests waiting under cgi_max_concurrent
+    STAT_CGI_QUEUE_ADMITTED,
+    STAT_CGI_QUEUE_WAIT_MS,     // summed over admitted requests
+    STAT_CGI_QUEUE_REJECTED,    // 503s: queue full or waited too long
+    STAT_CGI_COALESCED,         // requests answered by another request's CGI
+    STAT_CGI_CACHE_HITS,
+    STAT_CGI_CACHE_STALE,       // served past their lifetime while refreshed
+    STAT_CGI_CACHE_MISSES,
+    STAT_CGI_CACHE_EVICTIONS,
+    STAT_CGI_CACHE_ENTRIES,     // gauge
+    STAT_CGI_CACHE_BYTES,       // gauge
+    STAT_COUNT
+};
+
+namespace stats {
+    void add(StatCounter counter, long delta = 1);
+    long get(StatCounter counter);
+    std::string render();
+}
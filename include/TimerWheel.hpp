@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Milliseconds since an arbitrary point (CLOCK_MONOTONIC)
+typedef unsigned long long msec_t;
+
+msec_t monotonicMs();
+
+// What fired: `owner` and `kind` are whatever the caller stored in the timer
+struct TimerEvent {
+    int owner;
+    int kind;
+};
+
+// Hierarchical timing wheel (Varghese & Lauck). Level 0 has one slot per tick;
+// each higher level covers the whole span of the level below in one slot and is
+// cascaded down when the lower level wraps. Schedule and cancel are O(1).
+class TimerWheel
+{
+    public:
+        static const msec_t TICK_MS = 10;
+
+        // Intrusive node, embedded in whatever owns the timeout
+        struct Timer {
+            int owner;
+            int kind;
+            msec_t expires;     // in ticks
+            Timer *prev;
+            Timer *next;
+            Timer **bucket;     // slot head this timer is linked into, NULL if idle
+
+            Timer() : owner(-1), kind(0), expires(0), prev(NULL), next(NULL), bucket(NULL) {}
+            bool active() const { return bucket != NULL; }
+        };
+
+    private:
+        static const int LEVELS = 4;
+        static const int L0_BITS = 8;   // 256 ticks at level 0
+        static const int LN_BITS = 6;   // 64 slots on each upper level
+
+        std::vector<Timer *> slots[LEVELS];
+        msec_t now_tick;
+        size_t count;
+
+        static int shift(int level);
+        static int slotCount(int level);
+        void link(Timer &t);
+        void cascade(int level);
+
+        TimerWheel(const TimerWheel &);
+        TimerWheel &operator=(const TimerWheel &);
+
+    public:
+        TimerWheel();
+
+        void reset(msec_t now_ms);
+        void schedule(Timer &t, msec_t expires_ms);
+        void cancel(Timer &t);
+
+        // Move the wheel to now_ms and append every timer that fired
+        void advance(msec_t now_ms, std::vector<TimerEvent> &fired);
+
+        // Milliseconds until the wheel needs to be advanced again, -1 if empty
+        int nextTimeout(msec_t now_ms) const;
+
+        size_t size() const { return count; }
+};
@@ -2,6 +2,8 @@
 
 #include <string>
 #include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/socket.h>
 #include <vector>
 
 extern const char *HEADER_CONTENT_TYPE;
@@ -11,26 +13,29 @@ extern const char *MIME_HTML;
 
 namespace util {
 
-    struct MultipartPart
-    {
-        std::string filename;
-        std::string contentType;
-        std::string content;
-    };
-
     std::string normalizePath(const std::string &rawPath);
     std::string sanitizeFileName(const std::string &fileName);
     bool isValidPathChar(char c);
     bool isValidPath(const std::string &path);
     std::string intToString(int value);
     bool fileExists(const std::string &path, struct ::stat &st);
-    bool saveFile(const std::string &filePath, const std::string &fileContent);
     bool createUploadDir(const std::string &uploadFullPath);
         std::string wrapHtml(const std::string &title, const std::string &body);
     std::string generateAutoIndexHtml(const std::string &uri, const std::vector<std::string> &entries);
     std::string extractBoundary(std::string rawValue);
     std::string extractFilename(std::string headers);
     std::string extractContentType(std::string headers);
-    std::string parseChunkedBody(std::string &raw, int maxBodySize);
-    MultipartPart parseMultipartBody(const std::string &rawBody, const std::string &boundary);
+    ssize_t sendFileChunk(int sock, int fd, off_t &offset, size_t count);
+    std::string findExecutable(const std::string &name);
+    int openPidFd(pid_t pid);
+    bool openPipe(int fds[2]);
+    int openSocket(int domain, int type);
+    int openTempFile(std::string &path_template);
+    int acceptClient(int fd, struct sockaddr *addr, socklen_t *len);
+
+    // Starts `path` with posix_spawn(), which doesn't copy our address space,
+    // so the cost doesn't grow with the server's memory. fds[i] >= 0 becomes
+    // the child's fd i and `dir`, if set, its working directory; signals start
+    // unblocked and at their defaults. Returns the pid, or -1 with errno set.
+    pid_t spawnProcess(const char *path, char *const argv[], char *const envp[], const int fds[3], const char *dir);
 }
\ No newline at end of file
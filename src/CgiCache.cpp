@@ -0,0 +1,174 @@
+#include "CgiCache.hpp"
+#include "Response.hpp"
+#include "Stats.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+// Longest lifetime taken from a script, so the arithmetic below can't overflow
+static const long long MAX_LIFETIME_S = 365LL * 24 * 3600;
+
+static long long seconds(const std::string &value)
+{
+    const long long n = std::strtoll(value.c_str(), NULL, 10);
+    return std::max(0LL, std::min(n, MAX_LIFETIME_S));
+}
+
+// Lifetime and stale window the script gave its response with Cache-Control
+// or Expires (-1 where it gave none); false if it must not be cached at all
+static bool freshness(const std::string &output, long long &ttl_s, long long &stale_s)
+{
+    Response res;
+    if (res.parseCgiHeaders(output) == std::string::npos || res.getCode() != 200)
+        return false;
+
+    const std::map<std::string, std::string> headers = res.getHeaders();
+    long long max_age = -1;
+    long long s_maxage = -1;
+    const std::string *expires = NULL;
+
+    ttl_s = -1;
+    stale_s = -1;
+    for (std::map<std::string, std::string>::const_iterator it = headers.begin(); it != headers.end(); ++it) {
+        std::string key = it->first;
+        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+        if (key == "set-cookie")
+            return false;
+        if (key == "expires")
+            expires = &it->second;
+        if (key != "cache-control")
+            continue;
+
+        std::string value = it->second;
+        std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+        for (size_t pos = 0; pos < value.size(); ) {
+            size_t end = value.find(',', pos);
+            if (end == std::string::npos)
+                end = value.size();
+            std::string directive = value.substr(pos, end - pos);
+            directive.erase(0, directive.find_first_not_of(" \t"));
+            directive.erase(directive.find_last_not_of(" \t") + 1);
+            pos = end + 1;
+
+            if (directive == "no-store" || directive == "no-cache" || directive == "private")
+                return false;
+            if (directive.compare(0, 8, "max-age=") == 0)
+                max_age = seconds(directive.substr(8));
+            else if (directive.compare(0, 9, "s-maxage=") == 0)
+                s_maxage = seconds(directive.substr(9));
+            else if (directive.compare(0, 23, "stale-while-revalidate=") == 0)
+                stale_s = seconds(directive.substr(23));
+        }
+    }
+
+    // s-maxage is meant for shared caches like this one; max-age beats Expires
+    if (s_maxage >= 0)
+        ttl_s = s_maxage;
+    else if (max_age >= 0)
+        ttl_s = max_age;
+    else if (expires) {
+        // An Expires that doesn't parse means already expired (RFC 9111 5.3)
+        struct tm tm;
+        std::memset(&tm, 0, sizeof(tm));
+        const char *end = strptime(expires->c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        ttl_s = end ? std::max(0LL, std::min((long long)(timegm(&tm) - time(NULL)), MAX_LIFETIME_S)) : 0;
+    }
+    return true;
+}
+
+CgiCache::CgiCache(size_t max_bytes, int valid_ms, int stale_ms)
+    : max_bytes(max_bytes), valid_ms(valid_ms), stale_ms(stale_ms), bytes(0)
+{
+    pthread_mutex_init(&lock, NULL);
+}
+
+CgiCache::~CgiCache()
+{
+    while (!lru.empty())
+        erase(lru.begin());
+    pthread_mutex_destroy(&lock);
+}
+
+void CgiCache::erase(EntryList::iterator it)
+{
+    bytes -= it->output.size();
+    stats::add(STAT_CGI_CACHE_ENTRIES, -1);
+    stats::add(STAT_CGI_CACHE_BYTES, -(long)it->output.size());
+    index.erase(it->key);
+    lru.erase(it);
+}
+
+CgiCache::Status CgiCache::lookup(const std::string &key, std::string &output)
+{
+    pthread_mutex_lock(&lock);
+    std::map<std::string, EntryList::iterator>::iterator found = index.find(key);
+    const msec_t now = monotonicMs();
+    if (found != index.end() && now >= found->second->stale_until)
+        erase(found->second);
+    else if (found != index.end()) {
+        EntryList::iterator it = found->second;
+        Status status = HIT;
+        if (now >= it->fresh_until) {
+            // Only the first request past the lifetime refreshes the entry
+            status = it->refreshing ? STALE : REFRESH;
+            it->refreshing = true;
+        }
+        lru.splice(lru.begin(), lru, it);
+        output = it->output;
+        pthread_mutex_unlock(&lock);
+        stats::add(status == HIT ? STAT_CGI_CACHE_HITS : STAT_CGI_CACHE_STALE);
+        return status;
+    }
+    pthread_mutex_unlock(&lock);
+    stats::add(STAT_CGI_CACHE_MISSES);
+    return MISS;
+}
+
+void CgiCache::store(const std::string &key, const std::string &output)
+{
+    long long ttl_s;
+    long long stale_s;
+    const bool cacheable = freshness(output, ttl_s, stale_s) && fits(output.size());
+    const long long ttl_ms = ttl_s >= 0 ? ttl_s * 1000 : valid_ms;
+    const long long stale_ms_entry = stale_s >= 0 ? stale_s * 1000 : stale_ms;
+
+    pthread_mutex_lock(&lock);
+    std::map<std::string, EntryList::iterator>::iterator found = index.find(key);
+    if (found != index.end())
+        erase(found->second);
+    if (!cacheable || ttl_ms <= 0) {
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+
+    while (!lru.empty() && bytes + output.size() > max_bytes)
+    {
+        erase(--lru.end());
+        stats::add(STAT_CGI_CACHE_EVICTIONS);
+    }
+
+    const msec_t now = monotonicMs();
+    lru.push_front(Entry());
+    Entry &entry = lru.front();
+    entry.key = key;
+    entry.output = output;
+    entry.fresh_until = now + ttl_ms;
+    entry.stale_until = entry.fresh_until + stale_ms_entry;
+    entry.refreshing = false;
+    index[key] = lru.begin();
+    bytes += output.size();
+    stats::add(STAT_CGI_CACHE_ENTRIES);
+    stats::add(STAT_CGI_CACHE_BYTES, output.size());
+    pthread_mutex_unlock(&lock);
+}
+
+void CgiCache::abandon(const std::string &key)
+{
+    pthread_mutex_lock(&lock);
+    std::map<std::string, EntryList::iterator>::iterator found = index.find(key);
+    if (found != index.end())
+        found->second->refreshing = false;
+    pthread_mutex_unlock(&lock);
+}
@@ -20,40 +20,41 @@
 
 CgiHandler::CgiHandler(const Request &reqObj, const LocationConfig &locConfig)
     : cgiScriptPath("." + locConfig.getRoot() + reqObj.getReqPath()),
-      interpreterPath(getInterpreterPath(locConfig.getCgiExtension())),
+      interpreterPath(locConfig.findCgiInterpreter(reqObj.getReqPath()) ? *locConfig.findCgiInterpreter(reqObj.getReqPath()) : ""),
+      body_fd(reqObj.getBodyFd()),
       error(NO_ERROR),
       status_cgi(false)
 {
     std::string msg;
 
-	if (interpreterPath.empty()) {
+	const bool fastcgi = !locConfig.getFastCgiPass().empty();
+	if (interpreterPath.empty() && !fastcgi) {
 		error = EXECUTION_FAILED;
-        throw HttpException(500, "CGI interpreter not found for extension: " + locConfig.getCgiExtension(), true);
+        throw HttpException(500, "No CGI interpreter configured for: " + reqObj.getReqPath(), true);
     }
 
+	// A FastCGI backend resolves the script itself and reports a missing one
 	struct stat buffer;
-    util::fileExists(cgiScriptPath, buffer);
+	if (!fastcgi)
+    	util::fileExists(cgiScriptPath, buffer);
     logs(INFO, msg = "CGI Request: " + reqObj.getMethod() + " " + cgiScriptPath);
 
-    std::string transferEncoding = reqObj.findHeader("Transfer-Encoding") ? *reqObj.findHeader("Transfer-Encoding") : "";
-	if (transferEncoding == "chunked") {
-		std::string rawStream = reqObj.getBody();
-        body = util::parseChunkedBody(rawStream, reqObj.getMaxBodySize());
-    } else {
-		body = reqObj.getBody();
-	}
-
-	std::string contentType = reqObj.findHeader("Content-Type") ? *reqObj.findHeader("Content-Type") : "";
-    if (reqObj.getMethod() == "POST" && contentType.find("multipart/form-data") != std::string::npos) {
-
-        struct util::MultipartPart mp = util::parseMultipartBody(contentType, body);
-        util::saveFile(locConfig.getUploadDir(), mp.content);
-    }
+	// RequestParser already removed any chunked framing
+	body = reqObj.getBody();
 
 	env["REQUEST_METHOD"] = reqObj.getMethod();
 	env["SCRIPT_FILENAME"] = cgiScriptPath;
+	env["SCRIPT_NAME"] = reqObj.getReqPath();
+	if (fastcgi) {
+		// The backend runs in its own working directory
+		char cwd[4096];
+		if (getcwd(cwd, sizeof(cwd)))
+			env["SCRIPT_FILENAME"] = std::string(cwd) + locConfig.getRoot() + reqObj.getReqPath();
+	}
 	env["SERVER_PROTOCOL"] = reqObj.getVersion();
-	env["CONTENT_LENGTH"] = body.empty() ? "0" : util::intToString(body.size());
+	// A streamed body may still be arriving; the header has its full length
+	const std::string *contentLength = reqObj.findHeader(HEADER_CONTENT_LENGTH);
+	env["CONTENT_LENGTH"] = contentLength ? *contentLength : util::intToString(reqObj.getBodySize());
 
 	std::map<std::string, std::string> headers = reqObj.getHeaders();
     for (std::map<std::string, std::string>::iterator it = headers.begin(); it != headers.end(); ++it) {
@@ -73,97 +74,123 @@ CgiHandler::CgiHandler(const Request &reqObj, const LocationConfig &locConfig)
 	}
 }
 
+// The CGI reads a spilled body through a descriptor of its own, since the
+// parser closes its one when the next request starts
+int CgiHandler::shareBodyFile() const {
+    if (body_fd < 0)
+        return -1;
+    int fd = fcntl(body_fd, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0)
+        logs(ERROR, std::string("Cannot read request body file: ") + strerror(errno));
+    return fd;
+}
+
 // Non-blocking CGI execution - starts the CGI process and returns immediately
-bool CgiHandler::startCgi(Client &client) {
+bool CgiHandler::startCgi(Client &client, CgiPool *pool) {
     int inPipe[2], outPipe[2], errPipe[2];
 
-    // Create pipes
-    if (pipe(inPipe) == -1 || pipe(outPipe) == -1 || pipe(errPipe) == -1) {
+    // Create pipes; close-on-exec, so only the ends dup'ed onto 0-2 reach the child
+    if (!util::openPipe(inPipe) || !util::openPipe(outPipe) || !util::openPipe(errPipe)) {
         error = PIPE_FAILED;
         logs(ERROR, "Failed to create pipes");
         return false;
     }
 
-    pid_t pid = fork();
+    // Prefer a pre-spawned worker; spawn one only when none is idle
+    std::string scriptDir = cgiScriptPath.substr(0, cgiScriptPath.find_last_of('/'));
+    std::string scriptName = cgiScriptPath.substr(cgiScriptPath.find_last_of('/') + 1);
+    const int child_fds[3] = {inPipe[0], outPipe[1], errPipe[1]};
+    pid_t pid = -1;
+    if (pool)
+        pid = pool->dispatch(interpreterPath, scriptDir, scriptName, env, child_fds);
+    if (pid < 0) {
+        // argv and envp are built here; the child only execs
+        std::vector<std::string> entries;
+        for (std::map<std::string, std::string>::const_iterator it = env.begin(); it != env.end(); ++it)
+            entries.push_back(it->first + "=" + it->second);
+        std::vector<char *> envp;
+        for (size_t i = 0; i < entries.size(); ++i)
+            envp.push_back(const_cast<char *>(entries[i].c_str()));
+        envp.push_back(NULL);
+        char *argv[] = {const_cast<char *>(interpreterPath.c_str()), const_cast<char *>(scriptName.c_str()), NULL};
+
+        // Runs in the script's directory for relative path file access
+        pid = util::spawnProcess(interpreterPath.c_str(), argv, &envp[0], child_fds, scriptDir.c_str());
+    }
     if (pid < 0) {
-        error = FORK_FAILED;
-        logs(ERROR, "Fork failed");
+        error = (errno == EAGAIN || errno == ENOMEM) ? FORK_FAILED : EXECVE_FAILED;
+        logs(ERROR, std::string("CGI spawn failed: ") + strerror(errno));
         close(inPipe[0]); close(inPipe[1]);
         close(outPipe[0]); close(outPipe[1]);
         close(errPipe[0]); close(errPipe[1]);
         return false;
     }
 
-    if (pid == 0) { // Child process
-        dup2(inPipe[0], STDIN_FILENO);
-        dup2(outPipe[1], STDOUT_FILENO);
-        dup2(errPipe[1], STDERR_FILENO);
+    close(inPipe[0]);
+    close(outPipe[1]);
+    close(errPipe[1]);
 
+    // Set pipes to non-blocking mode
+    if (fcntl(inPipe[1], F_SETFL, O_NONBLOCK) < 0 ||
+        fcntl(outPipe[0], F_SETFL, O_NONBLOCK) < 0 ||
+        fcntl(errPipe[0], F_SETFL, O_NONBLOCK) < 0) {
+        logs(ERROR, "Failed to set CGI pipes to non-blocking mode");
         close(inPipe[1]);
         close(outPipe[0]);
         close(errPipe[0]);
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        return false;
+    }
 
-        // Prepare environment variables
-        std::vector<char *> envp;
-        for (std::map<std::string, std::string>::const_iterator it = env.begin(); it != env.end(); ++it) {
-            std::string entry = it->first + "=" + it->second;
-            envp.push_back(strdup(entry.c_str()));
-        }
-        envp.push_back(NULL);
-
-        // Change to script's directory for relative path file access
-        std::string scriptDir = cgiScriptPath.substr(0, cgiScriptPath.find_last_of('/'));
-        if (chdir(scriptDir.c_str()) != 0) {
-            perror("chdir failed");
-            _exit(EXIT_FAILURE);
-        }
+    // Store CGI context in client
+    Client::CgiContext &cgi = client.getCgiContext();
+    cgi.pid = pid;
+    cgi.stdin_fd = inPipe[1];
+    cgi.stdout_fd = outPipe[0];
+    cgi.stderr_fd = errPipe[0];
+    cgi.input_buffer.swap(body);
+    cgi.input_sent = 0;
+    cgi.body_fd = shareBodyFile();
+    cgi.body_offset = 0;
+    cgi.refillInput();
+    cgi.start_time = time(NULL);
+    cgi.stdin_closed = false;
+    cgi.stdout_closed = false;
+    cgi.stderr_closed = false;
+
+    status_cgi = true; // Successfully started
+    return true;
+}
 
-        // Prepare arguments
-        std::string scriptName = cgiScriptPath.substr(cgiScriptPath.find_last_of('/') + 1);
-        char *argv_fixed[] = {const_cast<char *>(interpreterPath.c_str()), const_cast<char *>(scriptName.c_str()), NULL};
-
-        // Execute the CGI script
-        if (execve(interpreterPath.c_str(), argv_fixed, &envp[0]) == -1) {
-            std::ostringstream oss;
-            oss << "CGI execve failed: " << strerror(errno);
-            std::string msg = oss.str();
-            logs(ERROR, msg);
-            _exit(EXIT_FAILURE);
-        }
-    } else { // Parent process
-        close(inPipe[0]);
-        close(outPipe[1]);
-        close(errPipe[1]);
-
-        // Set pipes to non-blocking mode
-        if (fcntl(inPipe[1], F_SETFL, O_NONBLOCK) < 0 ||
-            fcntl(outPipe[0], F_SETFL, O_NONBLOCK) < 0 ||
-            fcntl(errPipe[0], F_SETFL, O_NONBLOCK) < 0) {
-            logs(ERROR, "Failed to set CGI pipes to non-blocking mode");
-            close(inPipe[1]);
-            close(outPipe[0]);
-            close(errPipe[0]);
-            kill(pid, SIGKILL);
-            return false;
-        }
+// FastCGI: sends the request over a pooled backend connection instead of
+// starting a process; the event loop drives the socket from here
+bool CgiHandler::startFastCgi(Client &client, FastCgiPool &pool, const LocationConfig &locConfig) {
+    const std::string &address = locConfig.getFastCgiPass();
 
-        // Store CGI context in client
-        Client::CgiContext &cgi = client.getCgiContext();
-        cgi.pid = pid;
-        cgi.stdin_fd = inPipe[1];
-        cgi.stdout_fd = outPipe[0];
-        cgi.stderr_fd = errPipe[0];
-        cgi.input_buffer = body;
-        cgi.input_sent = 0;
-        cgi.start_time = time(NULL);
-        cgi.stdin_closed = false;
-        cgi.stdout_closed = false;
-        cgi.stderr_closed = false;
-
-        status_cgi = true; // Successfully started
-        return true;
+    int fd = pool.acquire(address);
+    if (fd < 0) {
+        error = BACKEND_UNAVAILABLE;
+        logs(ERROR, "Cannot connect to FastCGI backend " + address + ": " + strerror(errno));
+        return false;
     }
-    return false;
+
+    Client::CgiContext &cgi = client.getCgiContext();
+    cgi.fcgi_fd = fd;
+    cgi.fcgi_address = address;
+    cgi.fcgi_keepalive = locConfig.getFastCgiKeepalive();
+    cgi.input_buffer.clear();
+    cgi.body_fd = shareBodyFile();
+    cgi.body_offset = 0;
+    if (cgi.body_fd >= 0)
+        fcgi::encodeBegin(cgi.input_buffer, env, cgi.fcgi_keepalive > 0);
+    else
+        fcgi::encodeRequest(cgi.input_buffer, env, body, cgi.fcgi_keepalive > 0);
+    cgi.input_sent = 0;
+    cgi.start_time = time(NULL);
+
+    status_cgi = true;
+    return true;
 }
 
 // Finish CGI execution - process final output and return result
@@ -180,42 +207,3 @@ std::string CgiHandler::finishCgi(const Client &client, int exit_status) {
         return "";
     }
 }
-
-std::string getInterpreterPath(const std::string &cgiExtension) {
-    std::string interpreter;
-    std::string msg;
-    if (cgiExtension == ".py") {
-        interpreter = "python3";
-    } else if (cgiExtension == ".php") {
-        interpreter = "php"; // STILL TO BE TESTED
-    } else {
-        msg = "Unsupported CGI extension: " + cgiExtension;
-        logs(ERROR, msg);
-        return "";
-    }
-
-    std::string command = "which " + interpreter + " 2>/dev/null";
-    FILE *pipe = popen(command.c_str(), "r");
-    if (!pipe) {
-        msg = "Failed to execute `which` command for: " + interpreter;
-        logs(ERROR, msg);
-        return "";
-    }
-
-    char buffer[128];
-    std::ostringstream result;
-    while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-        result << buffer;
-    }
-    pclose(pipe);
-
-    std::string path = result.str();
-    if (!path.empty() && path[path.size() - 1] == '\n') {
-        path.erase(path.size() - 1);
-    }
-    if (path.empty()) {
-        msg = "Interpreter not found for: " + interpreter;
-        logs(ERROR, msg);
-    }
-    return path;
-}
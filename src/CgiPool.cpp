@@ -0,0 +1,302 @@
+#include "CgiPool.hpp"
+#include "Logger.hpp"
+#include "Stats.hpp"
+#include "Utils.hpp"
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern char **environ;
+
+std::string CgiPool::executable;
+std::string CgiPool::program_name;
+
+void CgiPool::setExecutable(const char *argv0)
+{
+    program_name = argv0;
+#ifdef __linux__
+    executable = "/proc/self/exe";
+#else
+    executable = argv0;
+#endif
+}
+
+CgiPool::~CgiPool()
+{
+    for (std::map<std::string, Group>::iterator it = groups.begin(); it != groups.end(); ++it) {
+        for (size_t i = 0; i < it->second.idle.size(); ++i)
+            retire(it->second.idle[i]);
+    }
+    // Retired workers exit as soon as they see EOF on their socket
+    for (size_t i = 0; i < exited.size(); ++i)
+        waitpid(exited[i], NULL, 0);
+}
+
+void CgiPool::configure(const std::string &interpreter, size_t min, size_t max, int idle_ms)
+{
+    std::map<std::string, Group>::iterator it = groups.find(interpreter);
+    if (it == groups.end()) {
+        Group group;
+        group.min = min;
+        group.max = max;
+        group.idle_ms = idle_ms;
+        group.target = min;
+        groups[interpreter] = group;
+        return;
+    }
+    Group &group = it->second;
+    group.min = std::max(group.min, min);
+    group.max = std::max(group.max, max);
+    group.idle_ms = std::max(group.idle_ms, idle_ms);
+    group.target = group.min;
+}
+
+bool CgiPool::spawn(Group &group, msec_t now)
+{
+    // Neither end may leak into CGI processes spawned meanwhile
+    int sv[2];
+#ifdef __linux__
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) {
+#else
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+#endif
+        logs(ERROR, std::string("CGI pool: socketpair failed: ") + strerror(errno));
+        return false;
+    }
+#ifndef __linux__
+    fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+    fcntl(sv[1], F_SETFD, FD_CLOEXEC);
+#endif
+
+    // The worker gets its end as stdin, which it replaces with the CGI's anyway
+    char *const argv[] = {const_cast<char *>(program_name.c_str()), const_cast<char *>(CGI_WORKER_FLAG),
+                          const_cast<char *>("0"), NULL};
+    const int child_fds[3] = {sv[1], -1, -1};
+
+    pid_t pid = util::spawnProcess(executable.c_str(), argv, environ, child_fds, NULL);
+    close(sv[1]);
+    if (pid < 0) {
+        logs(ERROR, std::string("CGI pool: spawn failed: ") + strerror(errno));
+        close(sv[0]);
+        return false;
+    }
+
+    Worker worker;
+    worker.pid = pid;
+    worker.sock = sv[0];
+    worker.idle_since = now;
+    group.idle.push_back(worker);
+    stats::add(STAT_CGI_POOL_IDLE);
+    return true;
+}
+
+void CgiPool::retire(Worker &worker)
+{
+    close(worker.sock);
+    exited.push_back(worker.pid);
+    stats::add(STAT_CGI_POOL_IDLE, -1);
+}
+
+pid_t CgiPool::dispatch(const std::string &interpreter, const std::string &dir, const std::string &script,
+                        const std::map<std::string, std::string> &env, const int child_fds[3])
+{
+    std::map<std::string, Group>::iterator it = groups.find(interpreter);
+    if (it == groups.end())
+        return -1;
+    Group &group = it->second;
+
+    // Length-prefixed list of NUL-terminated strings: interpreter, dir, script, then KEY=VALUE
+    std::string payload;
+    payload.append(interpreter).append(1, '\0');
+    payload.append(dir).append(1, '\0');
+    payload.append(script).append(1, '\0');
+    for (std::map<std::string, std::string>::const_iterator e = env.begin(); e != env.end(); ++e)
+        payload.append(e->first).append(1, '=').append(e->second).append(1, '\0');
+    const uint32_t len = htonl(payload.size());
+    payload.insert(0, reinterpret_cast<const char *>(&len), sizeof(len));
+
+    while (!group.idle.empty()) {
+        Worker worker = group.idle.back();
+        group.idle.pop_back();
+
+        struct iovec iov;
+        iov.iov_base = const_cast<char *>(payload.data());
+        iov.iov_len = payload.size();
+        char control[CMSG_SPACE(3 * sizeof(int))];
+        std::memset(control, 0, sizeof(control));
+        struct msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), child_fds, 3 * sizeof(int));
+
+        // A worker that died while idle shows up here; try the next one
+        ssize_t sent = sendmsg(worker.sock, &msg, MSG_DONTWAIT);
+        if (sent == static_cast<ssize_t>(payload.size())) {
+            close(worker.sock);
+            stats::add(STAT_CGI_POOL_IDLE, -1);
+            stats::add(STAT_CGI_POOL_HITS);
+            return worker.pid;
+        }
+        retire(worker);
+    }
+
+    // Demand outran the pool: keep one more warm, up to max
+    if (group.target < group.max)
+        group.target++;
+    stats::add(STAT_CGI_POOL_MISSES);
+    return -1;
+}
+
+bool CgiPool::maintain(msec_t now)
+{
+    bool busy = false;
+
+    for (std::map<std::string, Group>::iterator it = groups.begin(); it != groups.end(); ++it) {
+        Group &group = it->second;
+
+        // Workers beyond `min` that stayed idle too long are let go, oldest first
+        while (group.idle.size() > group.min && now - group.idle.front().idle_since >= (msec_t)group.idle_ms) {
+            retire(group.idle.front());
+            group.idle.erase(group.idle.begin());
+            group.target = std::max(group.min, group.idle.size());
+        }
+
+        // One spawn per group and wakeup keeps the loop responsive while filling up
+        if (group.idle.size() < group.target) {
+            if (spawn(group, now))
+                busy = busy || group.idle.size() < group.target;
+            else
+                group.target = group.idle.size();
+        }
+    }
+
+    for (size_t i = 0; i < exited.size(); ) {
+        pid_t result = waitpid(exited[i], NULL, WNOHANG);
+        if (result == 0) {
+            ++i;
+            continue;
+        }
+        exited[i] = exited.back();
+        exited.pop_back();
+    }
+    return busy || !exited.empty();
+}
+
+// Closes every fd inherited from the server except `keep`
+static void closeInheritedFds(int keep)
+{
+#ifdef __linux__
+    DIR *dir = opendir("/proc/self/fd");
+    if (dir) {
+        std::vector<int> fds;
+        const int dir_fd = dirfd(dir);
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.')
+                continue;
+            const int fd = std::atoi(entry->d_name);
+            if (fd > STDERR_FILENO && fd != keep && fd != dir_fd)
+                fds.push_back(fd);
+        }
+        closedir(dir);
+        for (size_t i = 0; i < fds.size(); ++i)
+            close(fds[i]);
+        return;
+    }
+#endif
+    long max_fd = sysconf(_SC_OPEN_MAX);
+    if (max_fd < 0 || max_fd > 65536)
+        max_fd = 65536;
+    for (int fd = STDERR_FILENO + 1; fd < max_fd; ++fd) {
+        if (fd != keep)
+            close(fd);
+    }
+}
+
+int runCgiWorker(int sock)
+{
+    closeInheritedFds(sock);
+
+    // Undo what the server set up, which exec would otherwise pass on to the CGI
+    sigset_t none;
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+    signal(SIGPIPE, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+
+    char buffer[65536];
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    struct iovec iov;
+    iov.iov_base = buffer;
+    iov.iov_len = sizeof(buffer);
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    // Blocks until a request comes; EOF means the pool retired this worker
+    ssize_t n = recvmsg(sock, &msg, 0);
+    if (n <= 0)
+        _exit(0);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (n < 4 || !cmsg || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+        _exit(EXIT_FAILURE);
+    int fds[3];
+    std::memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+    uint32_t len;
+    std::memcpy(&len, buffer, sizeof(len));
+    len = ntohl(len);
+    std::string payload(buffer + 4, n - 4);
+    while (payload.size() < len) {
+        n = read(sock, buffer, sizeof(buffer));
+        if (n <= 0)
+            _exit(EXIT_FAILURE);
+        payload.append(buffer, n);
+    }
+    close(sock);
+
+    std::vector<char *> fields;
+    for (size_t pos = 0; pos < payload.size(); pos = payload.find('\0', pos) + 1)
+        fields.push_back(&payload[pos]);
+    if (fields.size() < 3)
+        _exit(EXIT_FAILURE);
+
+    for (int i = 0; i < 3; ++i) {
+        dup2(fds[i], i);
+        if (fds[i] > STDERR_FILENO)
+            close(fds[i]);
+    }
+
+    // From here on this is the CGI process, as startCgi() would have forked it
+    if (chdir(fields[1]) != 0) {
+        perror("chdir failed");
+        _exit(EXIT_FAILURE);
+    }
+    std::vector<char *> envp(fields.begin() + 3, fields.end());
+    envp.push_back(NULL);
+    char *argv[] = {fields[0], fields[2], NULL};
+    execve(fields[0], argv, &envp[0]);
+    perror("CGI execve failed");
+    _exit(EXIT_FAILURE);
+}
@@ -1,39 +1,79 @@
 #include "Client.hpp"
+#include "Utils.hpp"
 
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/errno.h>
+#include <cstring>
 
 #include <iostream>
 #include <sstream>
 #include <map>
 
 Client::Client(int fd, int server_index) : client_fd(fd), server_idx(server_index),
-                                           current_state(CONNECTED), state_start_time(time(NULL)),
-                                           bytes_sent(0), port(-1), keep_alive(true), res(NULL) {};
-Client::~Client() {};
+                                           current_state(CONNECTED),
+                                           port(-1), keep_alive(true), streaming_body(false), upload(NULL), file_upload(NULL), res(NULL) {};
+Client::~Client() { delete upload; delete file_upload; };
 
 void Client::appendRequestData(char* buffer, int bytes) {
 	request_buffer.append(buffer, bytes);
 }
 
-bool Client::isTimedOut(int timeout_seconds) const {
-	return (time(NULL) - state_start_time) >= timeout_seconds;
+// Appended behind earlier responses, so pipelined requests are answered in order
+void Client::queueResponse(Response &response) {
+	response.queueInto(output);
+}
+
+// FastCGI gets the body framed as STDIN records, and the end of the file ends that stream
+void Client::CgiContext::refillInput() {
+	if (input_sent < input_buffer.size())
+		return;
+	input_buffer.clear();
+	input_sent = 0;
+	if (body_fd < 0)
+		return;
+
+	char buffer[65536];
+	const ssize_t n = pread(body_fd, buffer, sizeof(buffer), body_offset);
+	if (n > 0) {
+		body_offset += n;
+		if (fcgi_fd >= 0)
+			fcgi::encodeStdin(input_buffer, buffer, n);
+		else
+			input_buffer.append(buffer, n);
+		return;
+	}
+	if (n < 0)
+		logs(ERROR, std::string("Cannot read request body file: ") + strerror(errno));
+	close(body_fd);
+	body_fd = -1;
+	if (fcgi_fd >= 0)
+		fcgi::encodeStdin(input_buffer, "", 0);
+}
+
+// Takes ownership; an upload replaced or dropped unfinished leaves no files
+void Client::setUpload(MultipartUpload *u) {
+	delete upload;
+	upload = u;
+}
+
+void Client::setFileUpload(FileUpload *u) {
+	delete file_upload;
+	file_upload = u;
 }
 
 void Client::setState(State new_state) {
 	current_state = new_state;
-	state_start_time = time(NULL);
 }
 
 void Client::setKeepAlive(const Request &req)
 {
 	const std::string version = req.getVersion();
     std::string connection = "";
-    if (req.findHeader("Connection")) {
-        connection = *req.findHeader("Connection");
+    if (req.findHeader(HEADER_CONNECTION)) {
+        connection = *req.findHeader(HEADER_CONNECTION);
         for (size_t i = 0; i < connection.size(); ++i)
             connection[i] = (char)std::tolower(connection[i]);
     }
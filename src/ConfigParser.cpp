@@ -1,6 +1,11 @@
 #include "ConfigParser.hpp"
 #include "Config.hpp"
 #include "Utils.hpp"
+#include "FastCgi.hpp"
+#include "Logger.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
 
 inline void throwConfigError(const std::string &file, int line, const std::string &msg)
 {
@@ -12,6 +17,31 @@ inline bool isDirective(const std::vector<std::string> &tokens, const std::strin
     return !tokens.empty() && tokens[0] == name;
 }
 
+static TimeoutKind timeoutKind(const std::string &name)
+{
+    for (int k = 0; k < TIMEOUT_KINDS; ++k)
+    {
+        if (name == timeoutDirective(static_cast<TimeoutKind>(k)))
+            return static_cast<TimeoutKind>(k);
+    }
+    return TIMEOUT_KINDS;
+}
+
+inline bool isTimeoutDirective(const std::vector<std::string> &tokens)
+{
+    return !tokens.empty() && timeoutKind(tokens[0]) != TIMEOUT_KINDS;
+}
+
+// Interpreter looked up in $PATH for a cgi_extension without a cgi_interpreter
+static std::string defaultCgiInterpreter(const std::string &extension)
+{
+    if (extension == ".py")
+        return "python3";
+    if (extension == ".php")
+        return "php";
+    return "";
+}
+
 Config ConfigParser::parseConfigFile(const std::string &filename) {
     Config config;
     fileName = filename;
@@ -45,12 +75,81 @@ Config ConfigParser::parseConfigFile(const std::string &filename) {
                 config.addServer(server);
                 i += serverLines.size() + 1;
             }
+            else if (isDirective(tokens, "event_backend")) {
+                lineNum = i + 1;
+                config.setEventBackend(parseEventBackend(tokens));
+            }
+            else if (isDirective(tokens, "worker_processes")) {
+                lineNum = i + 1;
+                config.setWorkerProcesses(parseWorkerCount(tokens));
+            }
+            else if (isDirective(tokens, "worker_threads")) {
+                lineNum = i + 1;
+                config.setWorkerThreads(parseWorkerCount(tokens));
+            }
+            else if (isDirective(tokens, "thread_dispatch")) {
+                lineNum = i + 1;
+                config.setThreadDispatch(parseThreadDispatch(tokens));
+            }
         }
     }
 
     return (config);
 }
 
+Poller::Backend ConfigParser::parseEventBackend(const std::vector<std::string> &tokens)
+{
+    if (tokens.size() != 2)
+        throwConfigError(fileName, lineNum, "  event_backend expects exactly one value (poll or epoll)");
+
+    Poller::Backend backend = Poller::POLL;
+    if (!parseBackendName(tokens[1], backend))
+        throwConfigError(fileName, lineNum, "  Unknown event_backend '" + tokens[1] + "'");
+#ifndef __linux__
+    if (backend == Poller::EPOLL)
+        throwConfigError(fileName, lineNum, "  event_backend epoll is only available on Linux");
+#endif
+    return (backend);
+}
+
+// Shared by worker_processes and worker_threads: a count in [1, MAX_WORKERS] or "auto"
+int ConfigParser::parseWorkerCount(const std::vector<std::string> &tokens)
+{
+    const std::string &name = tokens[0];
+    if (tokens.size() != 2)
+        throwConfigError(fileName, lineNum, "  " + name + " expects exactly one value");
+
+    if (tokens[1] == "auto")
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        return (cpus > 0 ? static_cast<int>(cpus) : 1);
+    }
+
+    for (std::string::const_iterator it = tokens[1].begin(); it != tokens[1].end(); ++it)
+    {
+        if (!isdigit(*it))
+            throwConfigError(fileName, lineNum, "  " + name + " must be a number or 'auto'");
+    }
+
+    int workers = std::atoi(tokens[1].c_str());
+    if (workers < 1 || workers > MAX_WORKERS)
+        throwConfigError(fileName, lineNum, "  " + name + " out of range (1-" + util::intToString(MAX_WORKERS) + ")");
+    return (workers);
+}
+
+ThreadDispatch ConfigParser::parseThreadDispatch(const std::vector<std::string> &tokens)
+{
+    if (tokens.size() != 2)
+        throwConfigError(fileName, lineNum, "  thread_dispatch expects exactly one value (round_robin or least_loaded)");
+
+    if (tokens[1] == "round_robin")
+        return (DISPATCH_ROUND_ROBIN);
+    if (tokens[1] == "least_loaded")
+        return (DISPATCH_LEAST_LOADED);
+    throwConfigError(fileName, lineNum, "  Unknown thread_dispatch '" + tokens[1] + "'");
+    return (DISPATCH_ROUND_ROBIN);
+}
+
 std::vector<std::string> ConfigParser::collectBlock(std::vector<std::string> lines, size_t i) {
     std::vector<std::string> blockLines;
     int braceCount = 0;
@@ -89,17 +188,23 @@ ServerConfig ConfigParser::parseServerBlock(std::vector<std::string> lines) {
         else if (isDirective(tokens, "error_page"))
             servConfig.setErrorPagesConfig(parseErrorPageLine(tokens));
         else if (isDirective(tokens, "client_max_body_size"))
-            servConfig.setMaxBodySize(parseMaxBodySize(tokens));
+            servConfig.setMaxBodySize(parseSize(tokens));
+        else if (isDirective(tokens, "client_body_buffer_size"))
+            servConfig.setBodyBufferSize(parseSize(tokens));
+        else if (isDirective(tokens, "client_body_temp_path"))
+            servConfig.setBodyTempPath(parseTempPath(tokens));
+        else if (isTimeoutDirective(tokens))
+            servConfig.setTimeout(timeoutKind(tokens[0]), parseTimeout(tokens));
         else if (isDirective(tokens, "location"))
         {
             lineNum --;
             std::vector<std::string> locationLines = collectBlock(lines, i);
             LocationConfig loc = parseLocationBlock(locationLines);
+            if (loc.getMaxBodySize() == 1048576 && servConfig.getMaxBodySize() != 1048576)
+                loc.setMaxBodySize(servConfig.getMaxBodySize());
             servConfig.addLocation(loc);
             i += locationLines.size();
             lineNum ++;
-            if (loc.getMaxBodySize() == 1048576 && servConfig.getMaxBodySize() != 1048576)
-                loc.setMaxBodySize(servConfig.getMaxBodySize());
         }
         else if (!tokens.empty() && tokens[0] != "}")
             throwConfigError(fileName, lineNum, "   \"" + tokens[0] + "\" directive is not allowed here\n");
@@ -202,10 +307,55 @@ std::pair<int, std::string> ConfigParser::parseErrorPageLine(const std::vector<s
     return (entry);
 }
 
-size_t ConfigParser::parseMaxBodySize(const std::vector<std::string> &tokens)
+// A directory the server can create files in, checked now rather than on the first large request
+std::string ConfigParser::parseTempPath(const std::vector<std::string> &tokens)
+{
+    if (tokens.size() != 2)
+        throwConfigError(fileName, lineNum, "  " + tokens[0] + " expects one directory");
+
+    struct stat st;
+    if (stat(tokens[1].c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || access(tokens[1].c_str(), W_OK | X_OK) != 0)
+        throwConfigError(fileName, lineNum, "  " + tokens[0] + " '" + tokens[1] + "' is not a writable directory");
+    return (tokens[1]);
+}
+
+// "30", "30s" or "500ms"; returns milliseconds
+int ConfigParser::parseTimeout(const std::vector<std::string> &tokens)
+{
+    const std::string &name = tokens[0];
+    if (tokens.size() != 2)
+        throwConfigError(fileName, lineNum, "  " + name + " expects exactly one value");
+
+    std::string value = tokens[1];
+    long multiplier = 1000;
+    if (value.size() > 2 && value.compare(value.size() - 2, 2, "ms") == 0)
+    {
+        multiplier = 1;
+        value.resize(value.size() - 2);
+    }
+    else if (value.size() > 1 && value[value.size() - 1] == 's')
+        value.resize(value.size() - 1);
+
+    if (value.empty() || value.size() > 9)
+        throwConfigError(fileName, lineNum, "  Invalid " + name + " '" + tokens[1] + "'");
+    for (std::string::const_iterator it = value.begin(); it != value.end(); ++it)
+    {
+        if (!isdigit(*it))
+            throwConfigError(fileName, lineNum, "  Invalid " + name + " '" + tokens[1] + "'");
+    }
+
+    long ms = std::atol(value.c_str()) * multiplier;
+    if (ms <= 0 || ms > MAX_TIMEOUT_MS)
+        throwConfigError(fileName, lineNum, "  " + name + " out of range (1ms-24h)");
+    return (static_cast<int>(ms));
+}
+
+// Byte sizes with an optional k/m/g unit: client_max_body_size, file_cache_*, cgi_cache_size
+size_t ConfigParser::parseSize(const std::vector<std::string> &tokens)
 {
+    const std::string &name = tokens[0];
     if (tokens.size() < 2)
-        throwConfigError(fileName, lineNum, "  Error: Missing argument for client_max_body_size");
+        throwConfigError(fileName, lineNum, "  Error: Missing argument for " + name);
 
     std::string value = tokens[1];
     size_t multiplier = 1;
@@ -229,7 +379,7 @@ size_t ConfigParser::parseMaxBodySize(const std::vector<std::string> &tokens)
                 multiplier = 1024 * 1024 * 1024;
                 break;
             default:
-				throwConfigError(fileName, lineNum, "  Unknown size unit in client_max_body_size");
+				throwConfigError(fileName, lineNum, "  Unknown size unit in " + name);
         }
 
         value.resize(value.size() - 1);
@@ -237,7 +387,7 @@ size_t ConfigParser::parseMaxBodySize(const std::vector<std::string> &tokens)
 
     int number = std::atoi(value.c_str());
     if (number <= 0)
-        throwConfigError(fileName, lineNum, "  Invalid numeric value for client_max_body_size");
+        throwConfigError(fileName, lineNum, "  Invalid numeric value for " + name);
 
     return (static_cast<size_t>(number) * multiplier);
 }
@@ -246,6 +396,7 @@ LocationConfig ConfigParser::parseLocationBlock(std::vector<std::string> lines)
 {
     LocationConfig locConfig;
     std::vector<std::string> tokens;
+    size_t cgiExtensionLine = 0;
 
     for (size_t i = 0; i < lines.size(); i++)
     {
@@ -266,14 +417,70 @@ LocationConfig ConfigParser::parseLocationBlock(std::vector<std::string> lines)
             locConfig.setUploadDir(parseUploadDir(tokens));
         else if (isDirective(tokens, "autoindex"))
             locConfig.setAutoindex(parseAutoindex(tokens));
-        else if (isDirective(tokens, "cgi_extension"))
+        else if (isDirective(tokens, "cgi_extension")) {
         	locConfig.setCgiExtension(parseCgiExtension(tokens));
+            cgiExtensionLine = lineNum;
+        }
+        else if (isDirective(tokens, "fastcgi_pass"))
+            locConfig.setFastCgiPass(parseFastCgiPass(tokens));
+        else if (isDirective(tokens, "fastcgi_keepalive"))
+            locConfig.setFastCgiKeepalive(parseCount(tokens, 1024));
+        else if (isDirective(tokens, "cgi_pool_min"))
+            locConfig.setCgiPoolMin(parseCount(tokens, MAX_CGI_POOL));
+        else if (isDirective(tokens, "cgi_pool_max"))
+            locConfig.setCgiPoolMax(parseCount(tokens, MAX_CGI_POOL));
+        else if (isDirective(tokens, "cgi_pool_idle_timeout"))
+            locConfig.setCgiPoolIdle(parseTimeout(tokens));
+        else if (isDirective(tokens, "cgi_max_concurrent"))
+            locConfig.setCgiMaxConcurrent(parseCount(tokens, MAX_CGI_CONCURRENT));
+        else if (isDirective(tokens, "cgi_queue_size"))
+            locConfig.setCgiQueueSize(parseCount(tokens, MAX_CGI_QUEUE));
+        else if (isDirective(tokens, "cgi_coalesce"))
+            locConfig.setCgiCoalesce(parseOnOff(tokens));
+        else if (isDirective(tokens, "cgi_cache_size"))
+            locConfig.setCgiCacheSize(parseSize(tokens));
+        else if (isDirective(tokens, "cgi_cache_valid"))
+            locConfig.setCgiCacheValid(parseTimeout(tokens));
+        else if (isDirective(tokens, "cgi_cache_stale"))
+            locConfig.setCgiCacheStale(parseTimeout(tokens));
+        else if (isDirective(tokens, "cgi_interpreter")) {
+            std::pair<std::string, std::string> interpreter = parseCgiInterpreter(tokens);
+            locConfig.setCgiInterpreter(interpreter.first, interpreter.second);
+        }
         else if (isDirective(tokens, "client_max_body_size"))
-            locConfig.setMaxBodySize(parseMaxBodySize(tokens));
+            locConfig.setMaxBodySize(parseSize(tokens));
+        else if (isDirective(tokens, "file_cache_size"))
+            locConfig.setFileCacheSize(parseSize(tokens));
+        else if (isDirective(tokens, "file_cache_max_entry"))
+            locConfig.setFileCacheMaxEntry(parseSize(tokens));
+        else if (isDirective(tokens, "file_cache_valid"))
+            locConfig.setFileCacheValid(parseTimeout(tokens));
+        else if (isDirective(tokens, "stub_status"))
+            locConfig.setStubStatus(parseOnOff(tokens));
         else if (!tokens.empty() && tokens[0] != "}") {
             throwConfigError(fileName, lineNum, "   \"" + tokens[0] + "\" directive is not allowed here\n");
         }
     }
+
+    if (locConfig.getCgiPoolMin() > locConfig.getCgiPoolMax())
+        throwConfigError(fileName, lineNum, "  cgi_pool_min is larger than cgi_pool_max");
+    if (locConfig.isMethodAllowed("PUT") && locConfig.getUploadDir().empty())
+        throwConfigError(fileName, lineNum, "  allowed_methods: PUT needs an upload_path");
+
+    // Interpreters are resolved once here rather than per request; a missing one stops
+    // startup. An extension with no usual interpreter is kept without one: its requests get 500.
+    const std::string &extension = locConfig.getCgiExtension();
+    if (!extension.empty() && !locConfig.getCgiInterpreters().count(extension)) {
+        const std::string fallback = defaultCgiInterpreter(extension);
+        std::string path = fallback.empty() ? "" : util::findExecutable(fallback);
+        if (fallback.empty())
+            logs(ERROR, fileName + ":" + util::intToString(cgiExtensionLine) + "  no cgi_interpreter for CGI extension '"
+                        + extension + "'");
+        else if (path.empty())
+            throwConfigError(fileName, cgiExtensionLine, "  No interpreter found for CGI extension '" + extension
+                             + "'; set one with cgi_interpreter");
+        locConfig.setCgiInterpreter(extension, path);
+    }
     return (locConfig);
 }
 
@@ -359,7 +566,7 @@ std::vector<std::string> ConfigParser::parseAllowedMethods(const std::vector<std
             throwConfigError(fileName, lineNum, "  allowed_methods: empty method value is not allowed");
         }
 
-        if (method != "GET" && method != "POST" && method != "DELETE"){
+        if (method != "GET" && method != "POST" && method != "DELETE" && method != "PUT"){
             throwConfigError(fileName, lineNum, "  allowed_methods: unsupported HTTP method '" + method + "'");
         }
         if (seen.find(method) == seen.end()) {
@@ -436,14 +643,21 @@ bool ConfigParser::parseAutoindex(const std::vector<std::string> &tokens)
     return (false);
 }
 
-std::string ConfigParser::parseCgiExtension(const std::vector<std::string> &tokens)
+// Generic on/off flag for newer location directives
+bool ConfigParser::parseOnOff(const std::vector<std::string> &tokens)
 {
-	if (tokens.size() != 2) {
-		throwConfigError(fileName, lineNum, "Error: Exactly one CGI extension must be specified in the configuration file.");
-	}
-
-	const std::string &extension = tokens[1];
+    if (tokens.size() != 2)
+        throwConfigError(fileName, lineNum, "  " + tokens[0] + " expects on or off");
+    if (tokens[1] == "on")
+        return (true);
+    if (tokens[1] == "off")
+        return (false);
+    throwConfigError(fileName, lineNum, "  " + tokens[0] + " expects on or off");
+    return (false);
+}
 
+void ConfigParser::checkCgiExtension(const std::string &extension)
+{
 	if (extension.empty()) {
 		throwConfigError(fileName, lineNum, "Error: Empty CGI extension is not allowed.");
 	}
@@ -453,7 +667,30 @@ std::string ConfigParser::parseCgiExtension(const std::vector<std::string> &toke
 	if (!util::isValidPath(extension)) {
 		throwConfigError(fileName, lineNum, "Error: Invalid CGI extension '" + extension + "'.");
 	}
-	return extension;
+}
+
+std::string ConfigParser::parseCgiExtension(const std::vector<std::string> &tokens)
+{
+	if (tokens.size() != 2) {
+		throwConfigError(fileName, lineNum, "Error: Exactly one CGI extension must be specified in the configuration file.");
+	}
+	checkCgiExtension(tokens[1]);
+	return tokens[1];
+}
+
+// cgi_interpreter .ext /path/to/interpreter; a bare name is looked up in $PATH
+std::pair<std::string, std::string> ConfigParser::parseCgiInterpreter(const std::vector<std::string> &tokens)
+{
+	if (tokens.size() != 3) {
+		throwConfigError(fileName, lineNum, "  cgi_interpreter expects an extension and an interpreter path");
+	}
+	checkCgiExtension(tokens[1]);
+
+	std::string path = util::findExecutable(tokens[2]);
+	if (path.empty()) {
+		throwConfigError(fileName, lineNum, "  CGI interpreter '" + tokens[2] + "' not found or not executable");
+	}
+	return std::make_pair(tokens[1], path);
 }
 
 std::string cleanLine(std::string line)
@@ -484,3 +721,31 @@ std::vector<std::string> tokenize(const std::string line) {
     }
     return (tokens);
 }
+
+// fastcgi_pass unix:/path/to.sock | host:port
+std::string ConfigParser::parseFastCgiPass(const std::vector<std::string> &tokens)
+{
+	if (tokens.size() != 2) {
+		throwConfigError(fileName, lineNum, "  fastcgi_pass expects one address (unix:/path or host:port)");
+	}
+	std::string address = fcgi::resolveAddress(tokens[1]);
+	if (address.empty()) {
+		throwConfigError(fileName, lineNum, "  Invalid fastcgi_pass address '" + tokens[1] + "'");
+	}
+	return address;
+}
+
+// Small non-negative counts: fastcgi_keepalive, cgi_pool_*, cgi_max_concurrent, cgi_queue_size
+size_t ConfigParser::parseCount(const std::vector<std::string> &tokens, size_t limit)
+{
+	const std::string range = " expects a count (0-" + util::intToString(limit) + ")";
+	if (tokens.size() != 2 || tokens[1].empty() || tokens[1].size() > 9
+		|| tokens[1].find_first_not_of("0123456789") != std::string::npos) {
+		throwConfigError(fileName, lineNum, "  " + tokens[0] + range);
+	}
+	size_t count = static_cast<size_t>(std::atol(tokens[1].c_str()));
+	if (count > limit) {
+		throwConfigError(fileName, lineNum, "  " + tokens[0] + range);
+	}
+	return count;
+}
@@ -0,0 +1,2014 @@
+#include "EventLoop.hpp"
+#include "Config.hpp"
+#include "HttpException.hpp"
+#include "CgiHandler.hpp"
+#include "Request.hpp"
+#include "Response.hpp"
+#include "RequestParser.hpp"
+#include "Logger.hpp"
+#include "Utils.hpp"
+#include "Stats.hpp"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <cstdio>
+#include <sstream>
+#include <algorithm>
+#include <sys/wait.h>
+
+EventLoop::EventLoop(const std::vector<ServerConfig> &servers, Poller::Backend backend)
+    : servers(servers), backend(backend), client_count(0), cgi_polled(0), cgi_slots_freed(false), now_ms(0),
+      load(0), stop_requested(false)
+{
+    pthread_mutex_init(&lock, NULL);
+    wake_pipe[0] = -1;
+    wake_pipe[1] = -1;
+}
+
+EventLoop::~EventLoop()
+{
+    for (size_t i = 0; i < clients.size(); ++i)
+        delete clients[i];
+    for (size_t i = 0; i < pending.size(); ++i)
+        close(pending[i].fd);
+    if (wake_pipe[0] >= 0)
+        close(wake_pipe[0]);
+    if (wake_pipe[1] >= 0)
+        close(wake_pipe[1]);
+    pthread_mutex_destroy(&lock);
+}
+
+bool EventLoop::init()
+{
+    if (!poller.init(backend))
+        return false;
+
+    if (!util::openPipe(wake_pipe))
+    {
+        perror("pipe failed for event loop wakeup");
+        return false;
+    }
+    if (fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK) < 0 || fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK) < 0
+        || !poller.add(wake_pipe[0], POLLIN))
+    {
+        perror("event loop wakeup setup failed");
+        return false;
+    }
+    trackFd(wake_pipe[0], FD_WAKEUP, -1);
+
+    // Pools are per loop, keyed by interpreter, for locations that ask for one
+    for (size_t i = 0; i < servers.size(); ++i) {
+        const std::vector<LocationConfig> &locations = servers[i].getLocations();
+        for (size_t j = 0; j < locations.size(); ++j) {
+            const LocationConfig &loc = locations[j];
+            if (loc.getCgiPoolMax() == 0)
+                continue;
+            const std::map<std::string, std::string> &interpreters = loc.getCgiInterpreters();
+            for (std::map<std::string, std::string>::const_iterator it = interpreters.begin(); it != interpreters.end(); ++it)
+                if (!it->second.empty())
+                    cgi_pool.configure(it->second, loc.getCgiPoolMin(), loc.getCgiPoolMax(), loc.getCgiPoolIdle());
+        }
+    }
+
+    now_ms = monotonicMs();
+    timers.reset(now_ms);
+    return true;
+}
+
+bool EventLoop::addListener(int fd, int server_idx)
+{
+    if (!poller.add(fd, POLLIN))
+    {
+        perror("poller add failed for server socket");
+        return false;
+    }
+    trackFd(fd, FD_SERVER, server_idx);
+    return true;
+}
+
+void EventLoop::enqueueConnection(int fd, int server_idx, int port)
+{
+    PendingConnection conn = {fd, server_idx, port};
+
+    pthread_mutex_lock(&lock);
+    pending.push_back(conn);
+    load++;
+    pthread_mutex_unlock(&lock);
+
+    char byte = 0;
+    if (write(wake_pipe[1], &byte, 1) < 0 && errno != EAGAIN)
+        perror("event loop wakeup failed");
+}
+
+void EventLoop::stop()
+{
+    pthread_mutex_lock(&lock);
+    stop_requested = true;
+    pthread_mutex_unlock(&lock);
+
+    char byte = 0;
+    if (write(wake_pipe[1], &byte, 1) < 0 && errno != EAGAIN)
+        perror("event loop wakeup failed");
+}
+
+int EventLoop::getLoad()
+{
+    pthread_mutex_lock(&lock);
+    int n = load;
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+void EventLoop::setLoad(int n)
+{
+    pthread_mutex_lock(&lock);
+    load = n + pending.size();
+    pthread_mutex_unlock(&lock);
+}
+
+void EventLoop::drainWakeup()
+{
+    char buf[256];
+    while (read(wake_pipe[0], buf, sizeof(buf)) > 0)
+        ;
+
+    std::vector<PendingConnection> batch;
+    pthread_mutex_lock(&lock);
+    batch.swap(pending);
+    pthread_mutex_unlock(&lock);
+
+    for (size_t i = 0; i < batch.size(); ++i)
+        adoptClient(batch[i].fd, batch[i].server_idx, batch[i].port);
+}
+
+void EventLoop::trackFd(int fd, FdRole role, int slot)
+{
+    if ((size_t)fd >= fd_table.size())
+        fd_table.resize(fd + 1);
+    fd_table[fd].role = role;
+    fd_table[fd].slot = slot;
+}
+
+void EventLoop::untrackFd(int fd)
+{
+    if (fd < 0 || (size_t)fd >= fd_table.size())
+        return;
+    fd_table[fd] = FdEntry();
+}
+
+const FdEntry &EventLoop::lookupFd(int fd) const
+{
+    static const FdEntry none;
+    if (fd < 0 || (size_t)fd >= fd_table.size())
+        return none;
+    return fd_table[fd];
+}
+
+// Re-points every fd owned by the client in `slot` at that slot
+void EventLoop::retargetClientFds(int slot)
+{
+    const Client &client = *clients[slot];
+    const Client::CgiContext &cgi = client.getCgiContext();
+
+    fd_table[client.getFd()].slot = slot;
+    const int cgi_fds[5] = {cgi.stdin_fd, cgi.stdout_fd, cgi.stderr_fd, cgi.fcgi_fd, cgi.pid_fd};
+    for (int i = 0; i < 5; ++i) {
+        if (cgi_fds[i] >= 0 && lookupFd(cgi_fds[i]).role != FD_NONE)
+            fd_table[cgi_fds[i]].slot = slot;
+    }
+}
+
+void EventLoop::closeClient(int client_idx)
+{
+    Client *client = clients[client_idx];
+    const int fd = client->getFd();
+
+    if (client->getState() == Client::WAITING_CGI) {
+        Client::CgiContext &cgi = client->getCgiContext();
+        if (!cgi.followers.empty())
+            handOverCgi(client_idx);
+        if (cgi.pid > 0) {
+            kill(cgi.pid, SIGKILL);
+            waitpid(cgi.pid, NULL, 0);
+        }
+        finalizeCgiExecution(client_idx);
+    }
+
+    timers.cancel(client->getTimer());
+    timers.cancel(client->getCgiDeadline());
+    poller.remove(fd);
+    close(fd);
+    untrackFd(fd);
+    delete client;
+
+    // swap-remove: the last client takes over the freed slot
+    const int last = clients.size() - 1;
+    if (client_idx != last) {
+        clients[client_idx] = clients[last];
+        retargetClientFds(client_idx);
+    }
+    clients.pop_back();
+    client_count--;
+    setLoad(client_count);
+}
+
+void EventLoop::closeCgiFd(int client_idx, int fd)
+{
+    Client::CgiContext &cgi = clients[client_idx]->getCgiContext();
+
+    poller.remove(fd);
+    close(fd);
+    untrackFd(fd);
+    if (fd == cgi.stdin_fd) {
+        cgi.stdin_fd = -1;
+        cgi.stdin_closed = true;
+    } else if (fd == cgi.stdout_fd) {
+        cgi.stdout_fd = -1;
+        cgi.stdout_closed = true;
+    } else if (fd == cgi.stderr_fd) {
+        cgi.stderr_fd = -1;
+        cgi.stderr_closed = true;
+    }
+}
+
+bool EventLoop::run()
+{
+    std::vector<PollEvent> ready;
+
+    while (true)
+    {
+        runTimers();
+        if (cgi_slots_freed)
+            admitQueuedCgis();
+
+        // Sleep until the next deadline; poll faster only while a finished CGI without
+        // a pidfd awaits waitpid() or the CGI pool still has workers to start or reap
+        int timeout = timers.nextTimeout(now_ms);
+        const bool cgi_pending = checkCgiProcesses();
+        if ((cgi_pool.maintain(now_ms) || cgi_pending) && (timeout < 0 || timeout > CGI_REAP_POLL_MS))
+            timeout = CGI_REAP_POLL_MS;
+
+        int n = poller.wait(timeout, ready);
+        now_ms = monotonicMs();
+        if (n < 0 && errno == EINTR && !g_stop_signal)
+            continue;
+        if (n < 0)
+        {
+            const int err = errno;
+            cleanup();
+            if (err == EINTR) {
+                logs(INFO, "Signal received, shutting down the server...\n");
+                return true;
+            }
+            errno = err;
+            perror("poll failed");
+            return (false);
+        }
+
+        // Only fds with pending events are visited, whatever the backend
+        for (size_t k = 0; k < ready.size(); ++k)
+        {
+            const short revent = ready[k].revents;
+            const int fd = ready[k].fd;
+            const FdEntry entry = lookupFd(fd);
+            const bool is_cgi = entry.role == FD_CGI_STDIN || entry.role == FD_CGI_STDOUT
+                                || entry.role == FD_CGI_STDERR || entry.role == FD_FASTCGI
+                                || entry.role == FD_CGI_EXIT;
+
+            if (entry.role == FD_NONE)
+                continue; // closed earlier in this batch
+
+            // A CGI pipe can report POLLHUP together with its last bytes; drain those first
+            if ((revent & (POLLERR | POLLHUP | POLLNVAL)) && !(is_cgi && (revent & POLLIN))) {
+                std::ostringstream oss;
+
+                if (entry.role == FD_SERVER) {
+                    oss << "Critical poll event on server socket fd=" << fd;
+                    logs(ERROR, oss.str());
+                    cleanup();
+                    return false;
+                } else if (entry.role == FD_CLIENT) {
+                    if (revent & POLLERR) oss << "POLLERR ";
+                    if (revent & POLLHUP) oss << "POLLHUP ";
+                    if (revent & POLLNVAL) oss << "POLLNVAL ";
+                    oss << "event on client fd=" << fd << " port=" << servers[clients[entry.slot]->getServerIndex()].getPort();
+                    logs(INFO, oss.str());
+                    closeClient(entry.slot);
+                } else if (entry.role == FD_FASTCGI) {
+                    failFastCgi(entry.slot, "connection error");
+                } else if (entry.role == FD_CGI_EXIT) {
+                    reapCgi(entry.slot);
+                } else {
+                    // CGI file descriptor closed - this is normal when process completes
+                    // Don't immediately error out - let checkCgiProcesses handle completion
+                    closeCgiFd(entry.slot, fd);
+                }
+                continue;
+            }
+
+            switch (entry.role) {
+                case FD_SERVER:
+                    if (revent & POLLIN)
+                        handleNewConnection(fd, entry.slot);
+                    break;
+                case FD_CLIENT:
+                    try {
+                        Client &client = *clients[entry.slot];
+                        if (client.getState() == Client::WAITING_CGI) {
+                            // CGI completion and timeout are driven by checkCgiProcesses() and the timers;
+                            // meanwhile the request body may still stream in and earlier output drain
+                            if (revent & POLLIN)
+                                handleClientRequest(entry.slot);
+                            else if (revent & POLLOUT)
+                                handleResponse(entry.slot);
+                        } else if (revent & POLLIN) {
+                            handleClientRequest(entry.slot);
+                        } else if (revent & POLLOUT) {
+                            handleResponse(entry.slot);
+                        }
+                    } catch (const HttpException &e) {
+                        sendErrorResponse(entry.slot, e);
+                    }
+                    break;
+                case FD_CGI_STDIN:
+                    if (revent & POLLOUT)
+                        handleCgiStdin(entry.slot);
+                    break;
+                case FD_CGI_STDOUT:
+                    if (revent & POLLIN)
+                        handleCgiStdout(entry.slot);
+                    break;
+                case FD_CGI_STDERR:
+                    if (revent & POLLIN)
+                        handleCgiStderr(entry.slot);
+                    break;
+                case FD_FASTCGI:
+                    handleFastCgi(entry.slot, revent);
+                    break;
+                case FD_CGI_EXIT:
+                    reapCgi(entry.slot);
+                    break;
+                case FD_WAKEUP:
+                    drainWakeup();
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        // The flag covers a signal that came in while events were handled
+        pthread_mutex_lock(&lock);
+        bool stopping = stop_requested || g_stop_signal;
+        pthread_mutex_unlock(&lock);
+        if (stopping) {
+            cleanup();
+            return true;
+        }
+    }
+
+    return true;
+}
+
+void EventLoop::queueErrorResponse(int client_idx, const HttpException &e)
+{
+    Client &client = *clients[client_idx];
+    const ServerConfig &srv = servers[client.getServerIndex()];
+    Response res(srv.getErrorPagesConfig(), e.getStatusCode(), e.what(), e.getError());
+    client.queueResponse(res);
+    logs(ERROR, e.what());
+}
+
+void EventLoop::sendErrorResponse(int client_idx, const HttpException &e)
+{
+    Client &client = *clients[client_idx];
+    queueErrorResponse(client_idx, e);
+    if (client.getState() != Client::IDLE)
+        client.setState(Client::WAITING_RESPONSE);
+    scheduleClient(client_idx);
+}
+
+void EventLoop::armTimer(int client_idx, TimeoutKind kind)
+{
+    armTimer(client_idx, clients[client_idx]->getTimer(), kind);
+}
+
+void EventLoop::armTimer(int client_idx, TimerWheel::Timer &timer, TimeoutKind kind)
+{
+    Client &client = *clients[client_idx];
+
+    timer.owner = client.getFd();
+    timer.kind = kind;
+    timers.schedule(timer, now_ms + servers[client.getServerIndex()].getTimeout(kind));
+}
+
+void EventLoop::runTimers()
+{
+    fired.clear();
+    timers.advance(now_ms, fired);
+
+    // A handler may close other clients, so owners are looked up again by fd
+    for (size_t i = 0; i < fired.size(); ++i) {
+        const FdEntry &entry = lookupFd(fired[i].owner);
+        if (entry.role != FD_CLIENT)
+            continue;
+        try {
+            handleTimeout(entry.slot, static_cast<TimeoutKind>(fired[i].kind));
+        } catch (const HttpException &e) {
+            sendErrorResponse(entry.slot, e);
+        }
+    }
+}
+
+void EventLoop::handleTimeout(int client_idx, TimeoutKind kind)
+{
+    Client &client = *clients[client_idx];
+
+    switch (kind) {
+        case TIMEOUT_CGI:
+        case TIMEOUT_CGI_IDLE:
+            if (client.getState() == Client::WAITING_CGI)
+                handleCgiTimeout(client_idx);
+            break;
+        case TIMEOUT_CGI_QUEUE:
+            if (client.getState() == Client::WAITING_CGI && client.getCgiContext().queued) {
+                finalizeCgiExecution(client_idx);
+                queueCgiBusy(client_idx, "CGI queue timeout");
+                client.setState(Client::WAITING_RESPONSE);
+                processPipeline(client_idx);
+                scheduleClient(client_idx);
+            }
+            break;
+        case TIMEOUT_HEADER:
+        case TIMEOUT_BODY:
+            handleIdleClient(client_idx);
+            break;
+        default: {
+            // Nothing useful can be sent to a peer that stopped reading or went quiet
+            std::ostringstream oss;
+            oss << (kind == TIMEOUT_SEND ? "Send timeout" : "Keep-alive timeout") << " client fd="
+                << client.getFd() << " server_port=" << servers[client.getServerIndex()].getPort();
+            logs(INFO, oss.str());
+            closeClient(client_idx);
+            break;
+        }
+    }
+}
+
+void EventLoop::handleNewConnection(int server_fd, int server_idx)
+{
+    struct sockaddr_in client_addr;
+    socklen_t client_len = sizeof(client_addr);
+    int client_fd = util::acceptClient(server_fd, (struct sockaddr *)&client_addr, &client_len);
+
+    if (client_fd < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            perror("accept failed");
+        }
+        return;
+    }
+
+    adoptClient(client_fd, server_idx, ntohs(client_addr.sin_port));
+}
+
+void EventLoop::adoptClient(int client_fd, int server_idx, int port)
+{
+    if (client_count >= MAX_CLIENT)
+    {
+        std::string msg = "Refusing client, max reached";
+        logs(ERROR, msg);
+        close(client_fd);
+        return;
+    }
+
+    if (fcntl(client_fd, F_SETFL, O_NONBLOCK) < 0)
+    {
+        perror("fcntl failed for client");
+        close(client_fd);
+        return;
+    }
+
+    if (!poller.add(client_fd, POLLIN))
+    {
+        perror("poller add failed for client");
+        close(client_fd);
+        return;
+    }
+    clients.push_back(new Client(client_fd, server_idx));
+    trackFd(client_fd, FD_CLIENT, clients.size() - 1);
+    armTimer(clients.size() - 1, TIMEOUT_HEADER);
+
+    client_count++;
+    setLoad(client_count);
+
+    clients.back()->setPort(port);
+    std::ostringstream oss;
+    oss << "Accepted client fd=" << client_fd << " server_port=" << servers[server_idx].getPort();
+    std::string msg = oss.str();
+    logs(INFO, msg);
+}
+
+void EventLoop::handleIdleClient(int client_idx)
+{
+    Client &client = *clients[client_idx];
+    int server_idx = client.getServerIndex();
+
+    std::ostringstream oss;
+    oss << "Request Timeout client fd=" << client.getFd()
+        << " server_port=" << servers[server_idx].getPort();
+    std::string errorMessage = oss.str();
+
+    poller.modify(client.getFd(), POLLOUT);
+    client.setState(Client::IDLE);
+    client.setKeepAlive(false);
+
+    throw HttpException(408, errorMessage, true);
+}
+
+void EventLoop::handleClientRequest(int client_idx)
+{
+    Client &client = *clients[client_idx];
+    const int client_fd = client.getFd();
+
+    if (client.getState() == Client::CONNECTED)
+        client.setState(Client::SENDING_REQUEST);
+    if (client.getFileUpload())
+        return spliceFileUpload(client_idx);
+
+    char buffer[4096];
+    int bytes = recv(client_fd, buffer, sizeof(buffer) - 1, 0);
+    if (bytes < 0)
+    {
+        std::ostringstream oss;
+        oss << "recv() failed on client fd=" << client_fd << " server_port=" << servers[client.getServerIndex()].getPort();
+        std::string msg = oss.str();
+        logs(ERROR, msg);
+        closeClient(client_idx);
+        return;
+    }
+    if (bytes == 0)
+    {
+        std::ostringstream oss;
+        oss << "Disconnected client fd=" << client_fd << " server_port=" << servers[client.getServerIndex()].getPort();
+        std::string msg = oss.str();
+        logs(INFO, msg);
+        closeClient(client_idx);
+        return;
+    }
+    const ServerConfig &srv = servers[client.getServerIndex()];
+
+    // A new request starts the header clock; keep-alive idleness ends here
+    if (client.getParser().idle() && !client.hasPendingInput())
+        armTimer(client_idx, TIMEOUT_HEADER);
+    if (client.getPendingInput().size() >= (size_t)srv.getMaxBodySize())
+        throw HttpException(413, "Payload too large", true);
+    client.appendRequestData(buffer, bytes);
+    processPipeline(client_idx);
+    scheduleClient(client_idx);
+}
+
+// Answers every complete request in the client's input, queueing the responses
+// in request order. Stops at a CGI request, whose response has to come next, at
+// one that ends the connection, or when enough output is already waiting.
+void EventLoop::processPipeline(int client_idx)
+{
+    Client &client = *clients[client_idx];
+    RequestParser &parser = client.getParser();
+    const ServerConfig &srv = servers[client.getServerIndex()];
+    const OutputQueue &output = client.getOutput();
+
+    if (client.isStreamingBody()) {
+        feedCgiBody(client_idx);
+        if (client.isStreamingBody())
+            return;
+    }
+    if (client.getUpload()) {
+        feedUpload(client_idx);
+        if (client.getUpload())
+            return;
+    }
+    // Its body is read by spliceFileUpload(), not through the parser
+    if (client.getFileUpload())
+        return;
+
+    while (client.getState() != Client::WAITING_CGI && client.getState() != Client::IDLE
+           && client.getKeepAlive() && client.hasPendingInput()
+           && output.bufferedBytes() < PIPELINE_MAX_BYTES && output.segmentCount() < PIPELINE_MAX_SEGMENTS)
+    {
+        std::string &input = client.getPendingInput();
+        try {
+            parser.setBodyBuffer(srv.getBodyBufferSize(), srv.getBodyTempPath());
+            client.consumeRequestBytes(parser.feed(input.data(), input.size()));
+            if (parser.awaitingBody()) {
+                acceptBody(client_idx);
+                client.consumeRequestBytes(parser.feed(input.data(), input.size()));
+            }
+        } catch (const HttpException &e) {
+            // The rest of the stream can't be framed any more
+            client.setKeepAlive(false);
+            queueErrorResponse(client_idx, e);
+            return;
+        }
+        if (!parser.complete()) {
+            if (parser.getState() == RequestParser::BODY)
+                startCgiEarly(client_idx);
+            if (parser.headersDone() && !client.isStreamingBody()) {
+                startUpload(client_idx);
+                startFileUpload(client_idx);
+            }
+            return;
+        }
+
+        Request reqObj;
+        parser.take(reqObj);
+        client.setKeepAlive(reqObj);
+        try {
+            const LocationConfig *loc = matchLocation(reqObj.getReqPath(), srv);
+            if (!loc)
+                throw HttpException(404, "Not Found", true);
+            applyLocationConfig(reqObj, *loc);
+            reqObj.setMaxBodySize(loc->getMaxBodySize());
+            if (reqObj.isCgi()) {
+                handleCgiRequest(client_idx, reqObj, *loc);
+                continue;
+            }
+            Response res(srv.getErrorPagesConfig());
+            buildRequestAndResponse(res, reqObj, *loc);
+            client.queueResponse(res);
+        } catch (const HttpException &e) {
+            queueErrorResponse(client_idx, e);
+        }
+    }
+}
+
+// Sets poll interest and the pending timeout from what the client waits on
+void EventLoop::scheduleClient(int client_idx)
+{
+    Client &client = *clients[client_idx];
+    const int client_fd = client.getFd();
+    const OutputQueue &output = client.getOutput();
+
+    // The CGI timer stays armed; output may drain meanwhile, and a streamed body
+    // is read only as fast as the CGI takes it
+    if (client.getState() == Client::WAITING_CGI) {
+        const Client::CgiContext &cgi = client.getCgiContext();
+        const bool can_read = client.isStreamingBody()
+                              && cgi.input_buffer.size() - cgi.input_sent < CGI_BODY_HIGH_WATER;
+        poller.modify(client_fd, (can_read ? POLLIN : 0) | (output.empty() ? 0 : POLLOUT));
+        return;
+    }
+
+    const bool can_read = client.getKeepAlive() && client.getState() != Client::IDLE
+                          && output.bufferedBytes() < PIPELINE_MAX_BYTES
+                          && output.segmentCount() < PIPELINE_MAX_SEGMENTS;
+    if (!output.empty()) {
+        poller.modify(client_fd, can_read ? (POLLIN | POLLOUT) : POLLOUT);
+        armTimer(client_idx, TIMEOUT_SEND);
+        return;
+    }
+
+    poller.modify(client_fd, POLLIN);
+    const RequestParser &parser = client.getParser();
+    if (parser.headersDone())
+        // Each read restarts the body clock
+        armTimer(client_idx, TIMEOUT_BODY);
+    else if (parser.idle() && !client.hasPendingInput())
+        armTimer(client_idx, TIMEOUT_KEEPALIVE);
+    else if (client.getTimer().kind != TIMEOUT_HEADER || !client.getTimer().active())
+        armTimer(client_idx, TIMEOUT_HEADER);
+}
+
+void EventLoop::handleResponse(int client_idx)
+{
+    Client &client = *clients[client_idx];
+    int client_fd = client.getFd();
+    OutputQueue &output = client.getOutput();
+
+    if (!output.empty())
+    {
+        ssize_t bytes = output.flush(client_fd);
+        if (bytes < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return;
+            std::ostringstream oss;
+            oss << "send() failed on client fd=" << client_fd << " server_port=" << servers[client.getServerIndex()].getPort();
+            std::string msg = oss.str();
+            logs(ERROR, msg);
+            closeClient(client_idx);
+            return;
+        }
+        if (bytes > 0 && client.getState() != Client::WAITING_CGI)
+            armTimer(client_idx, TIMEOUT_SEND);
+    }
+
+    if (client.getState() == Client::WAITING_CGI)
+    {
+        // A CGI held back for this client may go on; more of its output comes next
+        const int leader = cgiLeader(client_idx);
+        if (clients[leader]->getCgiContext().paused && cgiBacklog(leader) < CGI_STREAM_HIGH_WATER / 2)
+            pauseCgiOutput(leader, false);
+        if (output.empty())
+            poller.modify(client_fd, 0);
+        return;
+    }
+    if (!output.empty())
+        return;
+    if (!client.getKeepAlive() || (client.getState() == Client::IDLE))
+    {
+        std::ostringstream oss;
+        oss << "Disconnecting client fd=" << client_fd << " server_port=" << servers[client.getServerIndex()].getPort();
+        std::string msg = oss.str();
+        logs(INFO, msg);
+        closeClient(client_idx);
+    }
+    else
+    {
+        // Requests held back while output was queued can be answered now
+        processPipeline(client_idx);
+        scheduleClient(client_idx);
+    }
+}
+
+// Checks a request's body against its location's limit before any of it is
+// read, so a refused body costs no bandwidth. A client waiting on Expect:
+// 100-continue is then told to send it.
+void EventLoop::acceptBody(int client_idx)
+{
+    Client &client = *clients[client_idx];
+    RequestParser &parser = client.getParser();
+    const Request &current = parser.current();
+    const ServerConfig &srv = servers[client.getServerIndex()];
+
+    // HTTP/1.0 has no interim responses, so its clients' Expect is ignored
+    const std::string *expect = current.getVersion() == "HTTP/1.1" ? current.findHeader("expect") : NULL;
+    std::string expectation = expect ? *expect : "";
+    std::transform(expectation.begin(), expectation.end(), expectation.begin(), ::tolower);
+    if (expect && expectation != "100-continue")
+        throw HttpException(417, "Expectation Failed", true);
+
+    const LocationConfig *loc = matchLocation(current.getReqPath(), srv);
+    parser.acceptBody(loc ? loc->getMaxBodySize() : srv.getMaxBodySize());
+
+    // A client already sending the body doesn't need it (RFC 9110 10.1.1)
+    if (expect && !client.hasPendingInput()) {
+        std::string interim = "HTTP/1.1 100 Continue\r\n\r\n";
+        client.getOutput().pushData(interim);
+    }
+}
+
+// Writes a multipart POST to an upload location out as its body arrives. The
+// request takes this path only where buildResponse() would reach handlePost(),
+// which then finds the files already on disk.
+void EventLoop::startUpload(int client_idx)
+{
+    Client &client = *clients[client_idx];
+    RequestParser &parser = client.getParser();
+    const Request &current = parser.current();
+
+    if (current.getMethod() != "POST")
+        return;
+    const LocationConfig *loc = matchLocation(current.getReqPath(), servers[client.getServerIndex()]);
+    if (!loc || loc->getUploadDir().empty() || !loc->getFastCgiPass().empty()
+        || loc->findCgiInterpreter(current.getReqPath()) || !loc->getReturnTarget().empty()
+        || !loc->isMethodAllowed("POST"))
+        return;
+
+    try {
+        MultipartUpload *upload = new MultipartUpload(*loc, current.findHeader(HEADER_CONTENT_TYPE));
+        client.setUpload(upload);
+        // The body received so far stays in the request; the parser delivers the rest
+        upload->processBody(current);
+        parser.setBodySink(&upload->input());
+    } catch (const HttpException &e) {
+        // The rest of the body is not read, so the connection can't carry another request
+        client.setUpload(NULL);
+        client.setKeepAlive(false);
+        queueErrorResponse(client_idx, e);
+    }
+}
+
+// Passes newly read body bytes to the client's upload; once the request is
+// complete, answers it the usual way
+void EventLoop::feedUpload(int client_idx)
+{
+    Client &client = *clients[client_idx];
+    RequestParser &parser = client.getParser();
+    std::string &input = client.getPendingInput();
+    const ServerConfig &srv = servers[client.getServerIndex()];
+
+    try {
+        client.consumeRequestBytes(parser.feed(input.data(), input.size()));
+        client.getUpload()->process();
+        if (!parser.complete())
+            return;
+    } catch (const HttpException &e) {
+        client.setUpload(NULL);
+        client.setKeepAlive(false);
+        queueErrorResponse(client_idx, e);
+        return;
+    }
+
+    Request reqObj;
+    parser.take(reqObj);
+    client.setKeepAlive(reqObj);
+    try {
+        const LocationConfig *loc = matchLocation(reqObj.getReqPath(), srv);
+        applyLocationConfig(reqObj, *loc);
+        reqObj.setMaxBodySize(loc->getMaxBodySize());
+        reqObj.setUpload(client.getUpload());
+        Response res(srv.getErrorPagesConfig());
+        buildRequestAndResponse(res, reqObj, *loc);
+        client.queueResponse(res);
+    } catch (const HttpException &e) {
+        queueErrorResponse(client_idx, e);
+    }
+    client.setUpload(NULL);
+}
+
+// Splices a PUT to an upload location into its file as the body arrives. Like
+// startUpload(), only where buildResponse() would reach handlePut(). Chunked
+// bodies are decoded by the parser and written out once complete.
+void EventLoop::startFileUpload(int client_idx)
+{
+    Client &client = *clients[client_idx];
+    RequestParser &parser = client.getParser();
+    const Request &current = parser.current();
+
+    if (current.getMethod() != "PUT" || parser.getState() != RequestParser::BODY)
+        return;
+    const LocationConfig *loc = matchLocation(current.getReqPath(), servers[client.getServerIndex()]);
+    if (!loc || loc->getUploadDir().empty() || !loc->getFastCgiPass().empty()
+        || loc->findCgiInterpreter(current.getReqPath()) || !loc->getReturnTarget().empty()
+        || !loc->isMethodAllowed("PUT"))
+        return;
+
+    try {
+        FileUpload *upload = new FileUpload(*loc, current.getReqPath());
+        client.setFileUpload(upload);
+        // Came in with the headers; the rest goes from the socket to the file
+        upload->processBody(current);
+    } catch (const HttpException &e) {
+        client.setFileUpload(NULL);
+        client.setKeepAlive(false);
+        queueErrorResponse(client_idx, e);
+    }
+}
+
+// Moves what the socket holds of the PUT body into the file. The parser only
+// counts those bytes, and none past the body are taken, so a pipelined request
+// after it is read the usual way.
+void EventLoop::spliceFileUpload(int client_idx)
+{
+    Client &client = *clients[client_idx];
+    RequestParser &parser = client.getParser();
+    const int client_fd = client.getFd();
+
+    size_t moved = 0;
+    ssize_t n = 0;
+    try {
+        while (moved < UPLOAD_SPLICE_BUDGET && parser.bodyRemaining() > 0)
+        {
+            n = client.getFileUpload()->transfer(client_fd, NULL, parser.bodyRemaining());
+            if (n <= 0)
+                break;
+            parser.skipBody(n);
+            moved += n;
+        }
+    } catch (const HttpException &e) {
+        client.setFileUpload(NULL);
+        client.setKeepAlive(false);
+        sendErrorResponse(client_idx, e);
+        return;
+    }
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+    {
+        std::ostringstream oss;
+        oss << (n == 0 ? "Disconnected" : "splice() failed on") << " client fd=" << client_fd
+            << " server_port=" << servers[client.getServerIndex()].getPort();
+        logs(n == 0 ? INFO : ERROR, oss.str());
+        closeClient(client_idx);
+        return;
+    }
+
+    if (parser.complete()) {
+        finishFileUpload(client_idx);
+        processPipeline(client_idx);
+    }
+    scheduleClient(client_idx);
+}
+
+void EventLoop::finishFileUpload(int client_idx)
+{
+    Client &client = *clients[client_idx];
+    RequestParser &parser = client.getParser();
+    const ServerConfig &srv = servers[client.getServerIndex()];
+
+    Request reqObj;
+    parser.take(reqObj);
+    client.setKeepAlive(reqObj);
+    try {
+        const LocationConfig *loc = matchLocation(reqObj.getReqPath(), srv);
+        applyLocationConfig(reqObj, *loc);
+        reqObj.setMaxBodySize(loc->getMaxBodySize());
+        reqObj.setFileUpload(client.getFileUpload());
+        Response res(srv.getErrorPagesConfig());
+        buildRequestAndResponse(res, reqObj, *loc);
+        client.queueResponse(res);
+    } catch (const HttpException &e) {
+        queueErrorResponse(client_idx, e);
+    }
+    client.setFileUpload(NULL);
+}
+
+void EventLoop::cleanup()
+{
+    while (!clients.empty())
+        closeClient(clients.size() - 1);
+    // Listeners belong to Config and the wakeup pipe to this loop's destructor
+    for (size_t fd = 0; fd < fd_table.size(); ++fd)
+    {
+        if (fd_table[fd].role == FD_NONE)
+            continue;
+        poller.remove(fd);
+        if (fd_table[fd].role != FD_SERVER && fd_table[fd].role != FD_WAKEUP)
+            close(fd);
+    }
+    fd_table.clear();
+    client_count = 0;
+    setLoad(0);
+}
+
+// CGI handling methods
+
+// Whether one CGI run may answer other clients too: a GET without a body or
+// credentials, whose output depends on nothing but the URL
+static bool sharableCgiRequest(const Client &client, const Request &reqObj)
+{
+    return reqObj.getMethod() == "GET" && !client.isStreamingBody() && reqObj.getBodySize() == 0
+           && !reqObj.findHeader("authorization") && !reqObj.findHeader("cookie");
+}
+
+// Method, path and query only: unlike the flight key, no location, as each location has its own cache
+static std::string cgiCacheKey(const Request &reqObj)
+{
+    return reqObj.getMethod() + " " + reqObj.getReqPath() + "?" + reqObj.getQueryString();
+}
+
+// Identifies the requests cgi_coalesce may answer with one CGI run: sharable
+// GETs of the same URL on the same host. Empty if the request runs on its own.
+static std::string cgiFlightKey(const Client &client, const Request &reqObj, const LocationConfig &locConfig)
+{
+    if (!locConfig.getCgiCoalesce() || !sharableCgiRequest(client, reqObj))
+        return "";
+
+    const std::string *host = reqObj.findHeader("host");
+    std::ostringstream key;
+    key << &locConfig << ' ' << (host ? *host : "") << ' ' << reqObj.getReqPath() << '?' << reqObj.getQueryString();
+    return key.str();
+}
+
+// Starts the CGI, unless cgi_max_concurrent of them already run for the
+// location: the request then waits its turn, or gets a 503 if the queue is full
+void EventLoop::handleCgiRequest(int client_idx, const Request &reqObj, const LocationConfig &locConfig) {
+    Client &client = *clients[client_idx];
+    const std::string flight = cgiFlightKey(client, reqObj, locConfig);
+
+    if (serveCachedCgi(client_idx, reqObj, locConfig))
+        return;
+    if (!flight.empty() && joinCgiFlight(client_idx, flight, reqObj))
+        return;
+
+    if (cgiSlotFree(locConfig)) {
+        launchCgi(client_idx, reqObj, locConfig);
+    } else {
+        std::deque<int> &waiting = cgi_admission[&locConfig].waiting;
+        if (waiting.size() >= locConfig.getCgiQueueSize()) {
+            queueCgiBusy(client_idx, "CGI queue full");
+            client.setState(Client::WAITING_RESPONSE);
+            return;
+        }
+
+        // The client reads nothing more until its CGI is done, as if it were running
+        Client::CgiContext &cgi = client.getCgiContext();
+        cgi.limit_location = &locConfig;
+        cgi.queued = true;
+        cgi.queued_at = now_ms;
+        cgi.queued_request = reqObj;
+        waiting.push_back(client.getFd());
+        stats::add(STAT_CGI_QUEUE_DEPTH);
+        client.setState(Client::WAITING_CGI);
+        armTimer(client_idx, TIMEOUT_CGI_QUEUE);
+    }
+
+    if (client.getState() != Client::WAITING_CGI)
+        return;
+    Client::CgiContext &cgi = client.getCgiContext();
+    if (locConfig.getCgiCache() && sharableCgiRequest(client, reqObj)) {
+        cgi.cache = locConfig.getCgiCache();
+        cgi.cache_key = cgiCacheKey(reqObj);
+    }
+    // Identical requests arriving meanwhile wait for this one's response
+    if (!flight.empty()) {
+        cgi.flight = flight;
+        cgi_flights[flight] = client.getFd();
+    }
+}
+
+// Answers a request from the location's CGI cache. The first request to find
+// an entry past its lifetime also runs the CGI, whose output only refreshes
+// the entry; that connection reads its next request once the refresh is done.
+bool EventLoop::serveCachedCgi(int client_idx, const Request &reqObj, const LocationConfig &locConfig) {
+    Client &client = *clients[client_idx];
+    CgiCache *cache = locConfig.getCgiCache();
+
+    if (!cache || !sharableCgiRequest(client, reqObj))
+        return false;
+    const std::string key = cgiCacheKey(reqObj);
+    std::string output;
+    const CgiCache::Status status = cache->lookup(key, output);
+    if (status == CgiCache::MISS)
+        return false;
+
+    Response res(servers[client.getServerIndex()].getErrorPagesConfig());
+    res.parseCgiResponse(output);
+    client.queueResponse(res);
+    if (status != CgiCache::REFRESH)
+        return true;
+
+    // A refresh waits for nobody: without a free slot the next request tries again
+    if (!cgiSlotFree(locConfig)) {
+        cache->abandon(key);
+        return true;
+    }
+    Client::CgiContext &cgi = client.getCgiContext();
+    cgi.cache = cache;
+    cgi.cache_key = key;
+    cgi.refresh = true;
+    launchCgi(client_idx, reqObj, locConfig);
+    return true;
+}
+
+// Keeps a finished CGI's complete output in the location's cache, if asked to
+void EventLoop::cacheCgiOutput(Client &client) {
+    Client::CgiContext &cgi = client.getCgiContext();
+
+    if (cgi.cache_key.empty())
+        return;
+    cgi.cache->store(cgi.cache_key, cgi.output_buffer);
+    cgi.cache_key.clear();
+}
+
+// Queues the outcome of a CGI run for the client and everyone coalesced with
+// it; a refresh's client was answered from the cache already
+void EventLoop::queueCgiResult(int client_idx, Response &res) {
+    Client &client = *clients[client_idx];
+    Client::CgiContext &cgi = client.getCgiContext();
+
+    shareCgiResponse(client_idx, res);
+    if (cgi.refresh && !cgi.cache_key.empty())
+        cgi.cache->abandon(cgi.cache_key);
+    if (!cgi.refresh)
+        client.queueResponse(res);
+    cgi.refresh = false;
+    cgi.cache_key.clear();
+}
+
+// Attaches the client to the CGI already running for an identical request;
+// false if there is none whose response could still be shared
+bool EventLoop::joinCgiFlight(int client_idx, const std::string &flight, const Request &reqObj) {
+    std::map<std::string, int>::iterator it = cgi_flights.find(flight);
+    if (it == cgi_flights.end() || lookupFd(it->second).role != FD_CLIENT)
+        return false;
+
+    Client &client = *clients[client_idx];
+    Client::CgiContext &cgi = client.getCgiContext();
+    clients[lookupFd(it->second).slot]->getCgiContext().followers.push_back(client.getFd());
+    cgi.leader_fd = it->second;
+    cgi.http11 = reqObj.getVersion() == "HTTP/1.1";
+    client.setState(Client::WAITING_CGI);
+    // The leader's timeout ends the wait for both
+    timers.cancel(client.getTimer());
+    stats::add(STAT_CGI_COALESCED);
+
+    std::ostringstream oss;
+    oss << "Coalesced CGI request: " << reqObj.getMethod() << " " << reqObj.getReqPath();
+    logs(INFO, oss.str());
+    return true;
+}
+
+// Stops identical requests from attaching to this client's CGI
+void EventLoop::closeCgiFlight(Client &client) {
+    Client::CgiContext &cgi = client.getCgiContext();
+
+    if (cgi.flight.empty())
+        return;
+    std::map<std::string, int>::iterator it = cgi_flights.find(cgi.flight);
+    if (it != cgi_flights.end() && it->second == client.getFd())
+        cgi_flights.erase(it);
+    cgi.flight.clear();
+}
+
+// Gives every client coalesced with this one a copy of its CGI's response
+void EventLoop::shareCgiResponse(int client_idx, Response &res) {
+    Client &client = *clients[client_idx];
+    std::vector<int> followers;
+
+    closeCgiFlight(client);
+    followers.swap(client.getCgiContext().followers);
+    if (followers.empty())
+        return;
+
+    const std::string head = res.writeHeaders();
+    const std::string body = res.getBody();
+    for (size_t i = 0; i < followers.size(); ++i) {
+        const FdEntry entry = lookupFd(followers[i]);
+        if (entry.role != FD_CLIENT)
+            continue;
+        Client &follower = *clients[entry.slot];
+        std::string follower_head = head;
+        std::string follower_body = body;
+
+        finalizeCgiExecution(entry.slot);
+        follower.getOutput().pushData(follower_head);
+        follower.getOutput().pushData(follower_body);
+        follower.setState(Client::WAITING_RESPONSE);
+        processPipeline(entry.slot);
+        scheduleClient(entry.slot);
+    }
+}
+
+// Passes the CGI of a client that is going away to the first client coalesced
+// with it, so that one and the rest still get their response
+void EventLoop::handOverCgi(int client_idx) {
+    Client &client = *clients[client_idx];
+    Client::CgiContext &cgi = client.getCgiContext();
+    const int heir_idx = lookupFd(cgi.followers.front()).slot;
+    Client &heir = *clients[heir_idx];
+    Client::CgiContext &next = heir.getCgiContext();
+
+    // The process, its fds and any buffered output move; the framing is per client
+    const Client::CgiContext own = next;
+    next = cgi;
+    next.http11 = own.http11;
+    next.streaming = own.streaming;
+    next.chunked = own.chunked;
+    next.stream_left = own.stream_left;
+    next.leader_fd = -1;
+    next.followers.erase(next.followers.begin());
+    for (size_t i = 0; i < next.followers.size(); ++i)
+        clients[lookupFd(next.followers[i]).slot]->getCgiContext().leader_fd = heir.getFd();
+    if (!next.flight.empty())
+        cgi_flights[next.flight] = heir.getFd();
+    if (next.queued) {
+        std::deque<int> &waiting = cgi_admission[next.limit_location].waiting;
+        std::replace(waiting.begin(), waiting.end(), client.getFd(), heir.getFd());
+    }
+    cgi = Client::CgiContext();
+    retargetClientFds(heir_idx);
+
+    // Same deadline as before
+    TimerWheel::Timer &timer = heir.getTimer();
+    timer.owner = heir.getFd();
+    timer.kind = client.getTimer().kind;
+    timers.schedule(timer, client.getTimer().expires * TimerWheel::TICK_MS);
+    if (client.getCgiDeadline().active()) {
+        TimerWheel::Timer &deadline = heir.getCgiDeadline();
+        deadline.owner = heir.getFd();
+        deadline.kind = TIMEOUT_CGI;
+        timers.schedule(deadline, client.getCgiDeadline().expires * TimerWheel::TICK_MS);
+        timers.cancel(client.getCgiDeadline());
+    }
+}
+
+// The client whose CGI answers this one's request
+int EventLoop::cgiLeader(int client_idx) {
+    const int leader_fd = clients[client_idx]->getCgiContext().leader_fd;
+    return leader_fd < 0 ? client_idx : lookupFd(leader_fd).slot;
+}
+
+// Most output still queued for any of the clients a CGI streams to
+size_t EventLoop::cgiBacklog(int client_idx) {
+    Client &client = *clients[client_idx];
+    const std::vector<int> &followers = client.getCgiContext().followers;
+    size_t backlog = client.getOutput().bufferedBytes();
+
+    for (size_t i = 0; i < followers.size(); ++i)
+        backlog = std::max(backlog, clients[lookupFd(followers[i]).slot]->getOutput().bufferedBytes());
+    return backlog;
+}
+
+bool EventLoop::cgiSlotFree(const LocationConfig &locConfig) {
+    if (locConfig.getCgiMaxConcurrent() == 0)
+        return true;
+    const CgiAdmission &admission = cgi_admission[&locConfig];
+    // Queued requests go first
+    return admission.running < locConfig.getCgiMaxConcurrent() && admission.waiting.empty();
+}
+
+// Starts queued CGI requests, oldest first, while their locations have slots
+void EventLoop::admitQueuedCgis() {
+    cgi_slots_freed = false;
+
+    std::map<const LocationConfig *, CgiAdmission>::iterator it;
+    for (it = cgi_admission.begin(); it != cgi_admission.end(); ++it) {
+        const LocationConfig &loc = *it->first;
+        CgiAdmission &admission = it->second;
+
+        while (!admission.waiting.empty() && admission.running < loc.getCgiMaxConcurrent()) {
+            const FdEntry &entry = lookupFd(admission.waiting.front());
+            admission.waiting.pop_front();
+            stats::add(STAT_CGI_QUEUE_DEPTH, -1);
+            if (entry.role != FD_CLIENT)
+                continue;
+
+            const int client_idx = entry.slot;
+            Client &client = *clients[client_idx];
+            Client::CgiContext &cgi = client.getCgiContext();
+            const Request reqObj = cgi.queued_request;
+            stats::add(STAT_CGI_QUEUE_ADMITTED);
+            stats::add(STAT_CGI_QUEUE_WAIT_MS, now_ms - cgi.queued_at);
+            cgi.limit_location = NULL;
+            cgi.queued = false;
+            cgi.queued_request = Request();
+
+            try {
+                launchCgi(client_idx, reqObj, loc);
+            } catch (const HttpException &e) {
+                queueErrorResponse(client_idx, e);
+                client.setState(Client::WAITING_RESPONSE);
+            }
+            if (client.getState() != Client::WAITING_CGI)
+                processPipeline(client_idx);
+            scheduleClient(client_idx);
+        }
+    }
+}
+
+// 503 for a CGI request that found no slot; Retry-After is the queue timeout
+void EventLoop::queueCgiBusy(int client_idx, const std::string &reason) {
+    Client &client = *clients[client_idx];
+    const ServerConfig &srv = servers[client.getServerIndex()];
+    Response res(srv.getErrorPagesConfig());
+
+    res.setPage(503, reason, true);
+    res.setHeader("Retry-After", util::intToString(std::max(1, (srv.getTimeout(TIMEOUT_CGI_QUEUE) + 999) / 1000)));
+    queueCgiResult(client_idx, res);
+    stats::add(STAT_CGI_QUEUE_REJECTED);
+    logs(ERROR, reason);
+}
+
+void EventLoop::launchCgi(int client_idx, const Request &reqObj, const LocationConfig &locConfig) {
+    Client &client = *clients[client_idx];
+
+    // Log processing CGI request
+    std::ostringstream oss;
+    oss << "Processing CGI request: " << reqObj.getMethod() << " " << reqObj.getReqPath();
+    logs(INFO, oss.str());
+
+    // Create CGI handler and start the process, or hand the request to a FastCGI backend
+    CgiHandler cgiHandler(reqObj, locConfig);
+    const bool fastcgi = !locConfig.getFastCgiPass().empty();
+
+    if (fastcgi ? cgiHandler.startFastCgi(client, fastcgi_pool, locConfig) : cgiHandler.startCgi(client, cgi_pool.empty() ? NULL : &cgi_pool)) {
+        client.setState(Client::WAITING_CGI);
+        client.getCgiContext().http11 = reqObj.getVersion() == "HTTP/1.1";
+        if (fastcgi) {
+            const int fd = client.getCgiContext().fcgi_fd;
+            poller.add(fd, POLLIN | POLLOUT);
+            trackFd(fd, FD_FASTCGI, client_idx);
+        } else {
+            addCgiPollFds(client_idx);
+        }
+        armTimer(client_idx, TIMEOUT_CGI_IDLE);
+        armTimer(client_idx, client.getCgiDeadline(), TIMEOUT_CGI);
+        if (locConfig.getCgiMaxConcurrent() > 0) {
+            cgi_admission[&locConfig].running++;
+            client.getCgiContext().limit_location = &locConfig;
+        }
+        oss.str(""); oss.clear();
+        oss << "Started CGI process for: " << reqObj.getReqPath();
+        logs(INFO, oss.str());
+    } else {
+        // Failed to start CGI process - generate error response
+        const ServerConfig &srv = servers[client.getServerIndex()];
+        Response res(srv.getErrorPagesConfig());
+
+        switch (cgiHandler.getError()) {
+            case CgiHandler::SCRIPT_NOT_FOUND:
+                oss.str(""); oss.clear();
+                oss << "The requested CGI script was not found: " << reqObj.getReqPath();
+                logs(ERROR, oss.str());
+                res.setPage(404, "CGI script not found", true);
+                break;
+            case CgiHandler::PIPE_FAILED:
+                logs(ERROR, "CGI execution failed: pipe creation failed");
+                res.setPage(500, "CGI execution failed: pipe creation failed", true);
+                break;
+            case CgiHandler::FORK_FAILED:
+                logs(ERROR, "CGI execution failed: fork failed");
+                res.setPage(500, "CGI execution failed: fork failed", true);
+                break;
+            case CgiHandler::BACKEND_UNAVAILABLE:
+                res.setPage(502, "FastCGI backend unavailable", true);
+                break;
+            case CgiHandler::EXECVE_FAILED:
+                logs(ERROR, "CGI execve failed");
+                res.setPage(500, "CGI execution failed: execve failed", true);
+                break;
+            case CgiHandler::EXECUTION_FAILED:
+                logs(ERROR, "CGI execution failed");
+                res.setPage(500, "CGI execution failed", true);
+                break;
+            default:
+                logs(ERROR, "CGI execution failed: unknown error");
+                res.setPage(500, "CGI execution failed: unknown error", true);
+                break;
+        }
+
+        // Still inside processPipeline(), which carries on with the next request
+        queueCgiResult(client_idx, res);
+        client.setState(Client::WAITING_RESPONSE);
+    }
+}
+
+// Starts a CGI as soon as the headers of a request with a Content-Length body
+// are in, so the body can go to its stdin as it arrives instead of being held
+// whole. Chunked bodies are still collected first: CGI needs CONTENT_LENGTH up
+// front. FastCGI requests are encoded in one piece, so they wait as well.
+void EventLoop::startCgiEarly(int client_idx) {
+    Client &client = *clients[client_idx];
+    RequestParser &parser = client.getParser();
+    const ServerConfig &srv = servers[client.getServerIndex()];
+
+    // Checked before copying the request, which holds the body received so far
+    const std::string &path = parser.current().getReqPath();
+    const LocationConfig *loc = matchLocation(path, srv);
+    if (!loc || !loc->getFastCgiPass().empty() || !loc->findCgiInterpreter(path))
+        return;
+    // With no slot the body is collected and the request queued once complete.
+    // One that already went to a temp file is read from there by the CGI.
+    if (!cgiSlotFree(*loc) || parser.current().getBodyFd() >= 0)
+        return;
+    Request reqObj = parser.current();
+    applyLocationConfig(reqObj, *loc);
+
+    // The body received so far is in reqObj; the parser delivers the rest to stdin
+    client.setKeepAlive(reqObj);
+    client.setStreamingBody(true);
+    parser.setBodySink(&client.getCgiContext().input_buffer);
+    reqObj.setMaxBodySize(loc->getMaxBodySize());
+    try {
+        handleCgiRequest(client_idx, reqObj, *loc);
+    } catch (const HttpException &e) {
+        queueErrorResponse(client_idx, e);
+        client.setState(Client::WAITING_RESPONSE);
+    }
+}
+
+// Moves request body bytes from the client's input towards the CGI's stdin.
+// If the CGI stopped reading or is gone, they are parsed and dropped, which
+// keeps the connection in sync for the next request.
+void EventLoop::feedCgiBody(int client_idx) {
+    Client &client = *clients[client_idx];
+    Client::CgiContext &cgi = client.getCgiContext();
+    RequestParser &parser = client.getParser();
+    std::string &input = client.getPendingInput();
+
+    client.consumeRequestBytes(parser.feed(input.data(), input.size()));
+    if (parser.complete()) {
+        Request done;
+        parser.take(done);
+        client.setStreamingBody(false);
+    }
+
+    if (cgi.stdin_fd < 0) {
+        cgi.input_buffer.clear();
+        cgi.input_sent = 0;
+    } else if (cgi.input_sent < cgi.input_buffer.size()) {
+        poller.modify(cgi.stdin_fd, POLLOUT);
+    } else if (!client.isStreamingBody()) {
+        closeCgiFd(client_idx, cgi.stdin_fd);
+    }
+    // Upload progress keeps a CGI that waits for its input alive, up to its run time
+    if (client.getState() == Client::WAITING_CGI)
+        armTimer(client_idx, TIMEOUT_CGI_IDLE);
+}
+
+void EventLoop::addCgiPollFds(int client_idx) {
+    Client &client = *clients[client_idx];
+    Client::CgiContext &cgi = client.getCgiContext();
+
+    // For GET requests or empty input, close stdin immediately
+    if (cgi.input_buffer.empty() && !client.isStreamingBody() && cgi.stdin_fd >= 0 && !cgi.stdin_closed) {
+        close(cgi.stdin_fd);
+        cgi.stdin_fd = -1;
+        cgi.stdin_closed = true;
+    }
+
+    // Add CGI stdin (for writing to CGI) only if we have data to send, now or as the body streams in
+    if (cgi.stdin_fd >= 0 && !cgi.stdin_closed) {
+        poller.add(cgi.stdin_fd, POLLOUT);
+        trackFd(cgi.stdin_fd, FD_CGI_STDIN, client_idx);
+    }
+
+    // Add CGI stdout (for reading from CGI)
+    if (cgi.stdout_fd >= 0 && !cgi.stdout_closed) {
+        poller.add(cgi.stdout_fd, POLLIN);
+        trackFd(cgi.stdout_fd, FD_CGI_STDOUT, client_idx);
+    }
+
+    // Add CGI stderr (for reading CGI errors)
+    if (cgi.stderr_fd >= 0 && !cgi.stderr_closed) {
+        poller.add(cgi.stderr_fd, POLLIN);
+        trackFd(cgi.stderr_fd, FD_CGI_STDERR, client_idx);
+    }
+
+    // The process's exit wakes the loop; without a pidfd, waitpid() is polled
+    cgi.pid_fd = util::openPidFd(cgi.pid);
+    if (cgi.pid_fd >= 0 && poller.add(cgi.pid_fd, POLLIN)) {
+        trackFd(cgi.pid_fd, FD_CGI_EXIT, client_idx);
+    } else {
+        if (cgi.pid_fd >= 0)
+            close(cgi.pid_fd);
+        cgi.pid_fd = -1;
+        cgi_polled++;
+    }
+}
+
+void EventLoop::removeCgiPollFds(int client_idx) {
+    Client &client = *clients[client_idx];
+    const Client::CgiContext &cgi = client.getCgiContext();
+
+    // Remove CGI file descriptors from poll set and maps
+    const int cgi_fds[5] = {cgi.stdin_fd, cgi.stdout_fd, cgi.stderr_fd, cgi.fcgi_fd, cgi.pid_fd};
+    for (int i = 0; i < 5; ++i) {
+        if (cgi_fds[i] >= 0 && lookupFd(cgi_fds[i]).role != FD_NONE) {
+            poller.remove(cgi_fds[i]);
+            untrackFd(cgi_fds[i]);
+        }
+    }
+
+    // Close file descriptors
+    if (cgi.stdin_fd >= 0 && !cgi.stdin_closed) {
+        close(cgi.stdin_fd);
+    }
+    if (cgi.stdout_fd >= 0 && !cgi.stdout_closed) {
+        close(cgi.stdout_fd);
+    }
+    if (cgi.stderr_fd >= 0 && !cgi.stderr_closed) {
+        close(cgi.stderr_fd);
+    }
+    // Still set only if the request did not complete, so the connection can't be reused
+    if (cgi.fcgi_fd >= 0) {
+        close(cgi.fcgi_fd);
+    }
+    if (cgi.pid_fd >= 0) {
+        close(cgi.pid_fd);
+    }
+}
+
+// Collects a client's CGI once it has exited and answers with its output.
+// Returns false while the process still runs; otherwise the client may be gone.
+bool EventLoop::reapCgi(int client_idx) {
+    Client &client = *clients[client_idx];
+    Client::CgiContext &cgi = client.getCgiContext();
+
+    if (client.getState() != Client::WAITING_CGI || cgi.pid <= 0)
+        return false;
+
+    // Check if CGI process has finished
+    int status;
+    pid_t result = waitpid(cgi.pid, &status, WNOHANG);
+
+    if (result > 0) {
+        // Process has finished - read any remaining output first
+        if (cgi.stdout_fd >= 0) {
+            char buffer[4096];
+            ssize_t bytes_read;
+            while ((bytes_read = read(cgi.stdout_fd, buffer, sizeof(buffer))) > 0) {
+                if (cgi.streaming)
+                    streamCgiBody(client_idx, buffer, bytes_read);
+                else
+                    cgi.output_buffer.append(buffer, bytes_read);
+            }
+        }
+        if (cgi.streaming) {
+            const bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+            if (!ok) {
+                std::ostringstream oss;
+                oss << "CGI script failed with exit status " << WEXITSTATUS(status) << " after its response started";
+                logs(ERROR, oss.str());
+            }
+            endCgiStream(client_idx, ok);
+            return true;
+        }
+
+        // Save the output buffer before finalizing (which resets the context)
+        std::string cgi_output = cgi.output_buffer;
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+            cacheCgiOutput(client);
+
+        finalizeCgiExecution(client_idx);
+
+        // Create response with CGI output
+        const ServerConfig &srv = servers[client.getServerIndex()];
+        Response res(srv.getErrorPagesConfig());
+
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            // CGI succeeded
+            std::ostringstream oss;
+            oss << "CGI execution was successful";
+            logs(INFO, oss.str());
+            res.setCode(200);
+            res.parseCgiResponse(cgi_output);
+        } else {
+            // CGI failed
+            std::ostringstream oss;
+            oss << "CGI script failed with exit status: " << WEXITSTATUS(status);
+            logs(ERROR, oss.str());
+            res.setPage(500, "CGI script failed", true);
+        }
+
+        finishCgiResponse(client_idx, res);
+        return true;
+    }
+    // A readable pidfd stays readable, so its exit must end the CGI even if
+    // the child was already reaped
+    if (result == 0 || (errno == ECHILD && cgi.pid_fd < 0))
+        return false;
+
+    // Error occurred
+    logs(ERROR, "waitpid failed for CGI process");
+    if (cgi.streaming) {
+        endCgiStream(client_idx, false);
+        return true;
+    }
+    finalizeCgiExecution(client_idx);
+
+    // Generate error response
+    const ServerConfig &srv = servers[client.getServerIndex()];
+    Response res(srv.getErrorPagesConfig());
+    res.setPage(500, "CGI process error", true);
+    finishCgiResponse(client_idx, res);
+    return true;
+}
+
+// Reaps finished CGI processes that have no pidfd to report their exit.
+// Returns true while one of them has closed its output but is not reaped yet,
+// since no fd event will tell when it is.
+bool EventLoop::checkCgiProcesses() {
+    bool awaiting_exit = false;
+
+    if (cgi_polled == 0)
+        return false;
+    for (size_t i = 0; i < clients.size(); ++i) {
+        const Client::CgiContext &cgi = clients[i]->getCgiContext();
+        if (cgi.pid <= 0 || cgi.pid_fd >= 0)
+            continue;
+        if (!reapCgi(i) && cgi.stdout_closed && cgi.stderr_closed)
+            awaiting_exit = true;
+    }
+    return awaiting_exit;
+}
+
+void EventLoop::handleCgiTimeout(int client_idx) {
+    Client &client = *clients[client_idx];
+    Client::CgiContext &cgi = client.getCgiContext();
+
+    std::ostringstream oss;
+    if (cgi.pid > 0) {
+        oss << "CGI script timed out, killing PID: " << cgi.pid;
+        kill(cgi.pid, SIGKILL);
+        waitpid(cgi.pid, NULL, 0);
+    } else {
+        oss << "FastCGI backend " << cgi.fcgi_address << " timed out";
+    }
+    logs(ERROR, oss.str());
+    if (cgi.streaming) {
+        endCgiStream(client_idx, false);
+        return;
+    }
+    finalizeCgiExecution(client_idx);
+
+    // Generate timeout error response
+    const ServerConfig &srv = servers[client.getServerIndex()];
+    Response res(srv.getErrorPagesConfig());
+    res.setPage(504, "CGI script timed out", true);
+    finishCgiResponse(client_idx, res);
+}
+
+void EventLoop::handleCgiStdin(int client_idx) {
+    Client &client = *clients[client_idx];
+    Client::CgiContext &cgi = client.getCgiContext();
+
+    if (cgi.stdin_closed) return;
+
+    // Write remaining input to CGI
+    if (cgi.input_sent < cgi.input_buffer.size()) {
+        const char *data = cgi.input_buffer.c_str() + cgi.input_sent;
+        size_t remaining = cgi.input_buffer.size() - cgi.input_sent;
+
+        ssize_t written = write(cgi.stdin_fd, data, remaining);
+        if (written > 0) {
+            cgi.input_sent += written;
+        } else if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            // Error writing to CGI; the rest of the body is dropped
+            std::cerr << "Error writing to CGI stdin: " << strerror(errno) << std::endl;
+            closeCgiFd(client_idx, cgi.stdin_fd);
+            cgi.input_buffer.clear();
+            cgi.input_sent = 0;
+            scheduleClient(client_idx);
+            return;
+        }
+    }
+
+    // A body kept in a temp file is read on once its last piece went out.
+    // Sent bytes are let go once they make up half the buffer, so a streamed
+    // body doesn't pile up and a buffered one isn't shifted on every write
+    cgi.refillInput();
+    if (cgi.input_sent > 0 && cgi.input_sent >= cgi.input_buffer.size() / 2) {
+        cgi.input_buffer.erase(0, cgi.input_sent);
+        cgi.input_sent = 0;
+    }
+
+    // Close stdin when all data is sent; a streamed body may still have more
+    if (cgi.input_buffer.empty()) {
+        if (client.isStreamingBody())
+            poller.modify(cgi.stdin_fd, 0);
+        else
+            closeCgiFd(client_idx, cgi.stdin_fd);
+    }
+    if (client.isStreamingBody())
+        scheduleClient(client_idx);
+}
+
+void EventLoop::handleCgiStdout(int client_idx) {
+    Client &client = *clients[client_idx];
+    Client::CgiContext &cgi = client.getCgiContext();
+
+    char buffer[16384];
+    ssize_t bytes_read = read(cgi.stdout_fd, buffer, sizeof(buffer));
+
+    if (bytes_read > 0) {
+        relayCgiOutput(client_idx, buffer, bytes_read);
+    } else if (bytes_read == 0) {
+        // EOF - CGI closed stdout
+        closeCgiFd(client_idx, cgi.stdout_fd);
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        // Error reading from CGI
+        std::cerr << "Error reading from CGI stdout: " << strerror(errno) << std::endl;
+        closeCgiFd(client_idx, cgi.stdout_fd);
+    }
+}
+
+void EventLoop::handleCgiStderr(int client_idx) {
+    Client &client = *clients[client_idx];
+    Client::CgiContext &cgi = client.getCgiContext();
+
+    char buffer[4096];
+    ssize_t bytes_read = read(cgi.stderr_fd, buffer, sizeof(buffer));
+
+    if (bytes_read > 0) {
+        cgi.error_buffer.append(buffer, bytes_read);
+    } else if (bytes_read == 0) {
+        // EOF - CGI closed stderr
+        closeCgiFd(client_idx, cgi.stderr_fd);
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        // Error reading from CGI
+        closeCgiFd(client_idx, cgi.stderr_fd);
+    }
+}
+
+void EventLoop::finalizeCgiExecution(int client_idx) {
+    removeCgiPollFds(client_idx);
+
+    // Reset CGI context
+    Client &client = *clients[client_idx];
+    timers.cancel(client.getCgiDeadline());
+    Client::CgiContext &cgi = client.getCgiContext();
+    if (cgi.pid > 0 && cgi.pid_fd < 0)
+        cgi_polled--;
+
+    // A coalesced request leaves its leader's list. The leader's followers and
+    // refresh flag are kept for the response its caller queues next.
+    closeCgiFlight(client);
+    if (cgi.leader_fd >= 0 && lookupFd(cgi.leader_fd).role == FD_CLIENT) {
+        std::vector<int> &peers = clients[lookupFd(cgi.leader_fd).slot]->getCgiContext().followers;
+        peers.erase(std::remove(peers.begin(), peers.end(), client.getFd()), peers.end());
+    }
+
+    // Give back the cgi_max_concurrent slot, or the place in its queue
+    if (cgi.limit_location) {
+        CgiAdmission &admission = cgi_admission[cgi.limit_location];
+        if (cgi.queued) {
+            std::deque<int>::iterator it = std::find(admission.waiting.begin(), admission.waiting.end(),
+                                                     client.getFd());
+            if (it != admission.waiting.end()) {
+                admission.waiting.erase(it);
+                stats::add(STAT_CGI_QUEUE_DEPTH, -1);
+            }
+        } else {
+            admission.running--;
+            cgi_slots_freed = true;
+        }
+    }
+    // A refresh that didn't get to store its output leaves the entry to the next request
+    if (cgi.refresh && !cgi.cache_key.empty())
+        cgi.cache->abandon(cgi.cache_key);
+    if (cgi.body_fd >= 0)
+        close(cgi.body_fd);
+    const bool refresh = cgi.refresh;
+    std::vector<int> followers;
+    followers.swap(cgi.followers);
+    cgi = Client::CgiContext();
+    cgi.followers.swap(followers);
+    cgi.refresh = refresh;
+}
+
+// Queues a finished CGI's response behind those already waiting, then moves on
+// to any requests pipelined after it
+void EventLoop::finishCgiResponse(int client_idx, Response &res) {
+    Client &client = *clients[client_idx];
+
+    queueCgiResult(client_idx, res);
+    client.setState(Client::WAITING_RESPONSE);
+    processPipeline(client_idx);
+    scheduleClient(client_idx);
+}
+
+// Passes CGI output on. It is buffered until the header block and the first
+// body bytes are in, so a script that fails or hangs before writing a body still
+// gets an error page; after that it goes to the client as it arrives.
+void EventLoop::relayCgiOutput(int client_idx, const char *data, size_t len) {
+    Client &client = *clients[client_idx];
+    Client::CgiContext &cgi = client.getCgiContext();
+
+    if (cgi.streaming) {
+        streamCgiBody(client_idx, data, len);
+    } else {
+        cgi.output_buffer.append(data, len);
+        // Output that may be cached is held whole, unless it outgrows the cache
+        if (!cgi.cache_key.empty() && cgi.cache->fits(cgi.output_buffer.size()))
+            return;
+        if (cgi.refresh) {
+            // The client has its response already; the rest is read and dropped
+            if (!cgi.cache_key.empty())
+                cgi.cache->abandon(cgi.cache_key);
+            cgi.cache_key.clear();
+            cgi.output_buffer.clear();
+            return;
+        }
+        cgi.cache_key.clear();
+        startCgiStream(client_idx);
+        if (!cgi.streaming)
+            return;
+    }
+
+    // Output is progress: the idle timeout starts over, the run time does not
+    armTimer(client_idx, TIMEOUT_CGI_IDLE);
+    if (cgiBacklog(client_idx) >= CGI_STREAM_HIGH_WATER)
+        pauseCgiOutput(client_idx, true);
+    scheduleClient(client_idx);
+}
+
+// Queues the response head once the body has started. Without a Content-Length
+// from the script the body is sent chunked, or until close to an HTTP/1.0 client.
+void EventLoop::startCgiStream(int client_idx) {
+    Client &client = *clients[client_idx];
+    Client::CgiContext &cgi = client.getCgiContext();
+
+    if (!beginCgiStream(client, cgi.output_buffer))
+        return;
+
+    // Coalesced clients get the same head, framed for each; no one joins mid-body
+    closeCgiFlight(client);
+    for (size_t i = 0; i < cgi.followers.size(); ++i) {
+        const int follower_idx = lookupFd(cgi.followers[i]).slot;
+        beginCgiStream(*clients[follower_idx], cgi.output_buffer);
+        scheduleClient(follower_idx);
+    }
+    cgi.output_buffer.clear();
+}
+
+// Queues the head parsed from `output` for one client, then the body bytes
+// that came with it; false until the header block and some body are in
+bool EventLoop::beginCgiStream(Client &client, const std::string &output) {
+    Client::CgiContext &cgi = client.getCgiContext();
+    const ServerConfig &srv = servers[client.getServerIndex()];
+    Response res(srv.getErrorPagesConfig());
+
+    const size_t body = res.parseCgiHeaders(output);
+    if (body == std::string::npos || body == output.size())
+        return false;
+
+    const std::string *length = res.findHeader(HEADER_CONTENT_LENGTH);
+    if (length) {
+        cgi.stream_left = std::strtoll(length->c_str(), NULL, 10);
+    } else if (cgi.http11) {
+        res.setHeader("Transfer-Encoding", "chunked");
+        cgi.chunked = true;
+    } else {
+        res.setHeader(HEADER_CONNECTION, "close");
+        client.setKeepAlive(false);
+    }
+    client.queueResponse(res);
+    cgi.streaming = true;
+    pushCgiBody(client, output.data() + body, output.size() - body);
+    return true;
+}
+
+// Sends streamed output to the client and to every client coalesced with it
+void EventLoop::streamCgiBody(int client_idx, const char *data, size_t len) {
+    Client &client = *clients[client_idx];
+    const std::vector<int> &followers = client.getCgiContext().followers;
+
+    pushCgiBody(client, data, len);
+    for (size_t i = 0; i < followers.size(); ++i) {
+        const int follower_idx = lookupFd(followers[i]).slot;
+        pushCgiBody(*clients[follower_idx], data, len);
+        scheduleClient(follower_idx);
+    }
+}
+
+void EventLoop::pushCgiBody(Client &client, const char *data, size_t len) {
+    Client::CgiContext &cgi = client.getCgiContext();
+
+    // Bytes past the declared length would be read as the next response
+    if (cgi.stream_left >= 0) {
+        len = std::min(len, (size_t)cgi.stream_left);
+        cgi.stream_left -= len;
+    }
+    if (len == 0)
+        return;
+
+    std::string segment;
+    if (cgi.chunked) {
+        std::ostringstream size;
+        size << std::hex << len << "\r\n";
+        segment = size.str();
+    }
+    segment.append(data, len);
+    if (cgi.chunked)
+        segment += "\r\n";
+    client.getOutput().pushData(segment);
+}
+
+// Stops or resumes reading the CGI's output. The fd leaves the poller while
+// paused, since a hangup would otherwise be reported before the data is read.
+void EventLoop::pauseCgiOutput(int client_idx, bool pause) {
+    Client::CgiContext &cgi = clients[client_idx]->getCgiContext();
+
+    if (cgi.paused == pause)
+        return;
+    cgi.paused = pause;
+    if (cgi.fcgi_fd >= 0) {
+        if (pause)
+            poller.remove(cgi.fcgi_fd);
+        else
+            poller.add(cgi.fcgi_fd, cgi.input_sent < cgi.input_buffer.size() ? (POLLIN | POLLOUT) : POLLIN);
+    } else if (cgi.stdout_fd >= 0) {
+        if (pause)
+            poller.remove(cgi.stdout_fd);
+        else
+            poller.add(cgi.stdout_fd, POLLIN);
+    }
+}
+
+// Ends a streamed CGI response. A failure can no longer change the status, so
+// the connection is closed instead and the client sees a truncated body.
+void EventLoop::endCgiStream(int client_idx, bool ok) {
+    Client &client = *clients[client_idx];
+    const int client_fd = client.getFd();
+    const bool complete = ok && client.getCgiContext().stream_left <= 0;
+    const bool chunked = client.getCgiContext().chunked;
+    std::vector<int> followers;
+
+    followers.swap(client.getCgiContext().followers);
+    finalizeCgiExecution(client_idx);
+    if (complete && chunked) {
+        std::string last = "0\r\n\r\n";
+        client.getOutput().pushData(last);
+    }
+    if (!complete)
+        client.setKeepAlive(false);
+    client.setState(Client::WAITING_RESPONSE);
+    if (!client.getKeepAlive() && client.getOutput().empty()) {
+        closeClient(client_idx);
+    } else {
+        processPipeline(client_idx);
+        scheduleClient(client_idx);
+    }
+
+    // Coalesced clients end the same way; closing one may have moved the others
+    for (size_t i = 0; i < followers.size(); ++i) {
+        const FdEntry entry = lookupFd(followers[i]);
+        if (entry.role == FD_CLIENT && entry.slot >= 0 && clients[entry.slot]->getCgiContext().leader_fd == client_fd)
+            endCgiStream(entry.slot, ok);
+    }
+}
+
+// FastCGI socket events: the encoded request goes out, records come back
+void EventLoop::handleFastCgi(int client_idx, short revents) {
+    Client::CgiContext &cgi = clients[client_idx]->getCgiContext();
+
+    if ((revents & POLLOUT) && cgi.input_sent < cgi.input_buffer.size()) {
+        ssize_t written = send(cgi.fcgi_fd, cgi.input_buffer.data() + cgi.input_sent,
+                               cgi.input_buffer.size() - cgi.input_sent, 0);
+        if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            failFastCgi(client_idx, strerror(errno));
+            return;
+        }
+        if (written > 0)
+            cgi.input_sent += written;
+        // A body kept in a temp file is sent a piece at a time
+        cgi.refillInput();
+        if (cgi.input_buffer.empty() && !cgi.paused)
+            poller.modify(cgi.fcgi_fd, POLLIN);
+    }
+
+    if (!(revents & (POLLIN | POLLHUP)))
+        return;
+    char buffer[16384];
+    ssize_t bytes_read = recv(cgi.fcgi_fd, buffer, sizeof(buffer), 0);
+    if (bytes_read < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            failFastCgi(client_idx, strerror(errno));
+        return;
+    }
+    if (bytes_read == 0) {
+        failFastCgi(client_idx, "connection closed before the end of the response");
+        return;
+    }
+    std::string output;
+    if (!cgi.fcgi_reply.feed(buffer, bytes_read, output, cgi.error_buffer)) {
+        failFastCgi(client_idx, "malformed FastCGI record");
+        return;
+    }
+    if (!output.empty())
+        relayCgiOutput(client_idx, output.data(), output.size());
+    if (cgi.fcgi_reply.done())
+        completeFastCgi(client_idx);
+}
+
+void EventLoop::completeFastCgi(int client_idx) {
+    Client &client = *clients[client_idx];
+    Client::CgiContext &cgi = client.getCgiContext();
+    const ServerConfig &srv = servers[client.getServerIndex()];
+    Response res(srv.getErrorPagesConfig());
+    const bool ok = cgi.fcgi_reply.getProtocolStatus() == fcgi::REQUEST_COMPLETE;
+
+    if (!cgi.error_buffer.empty())
+        logs(ERROR, "FastCGI stderr: " + cgi.error_buffer.substr(0, cgi.error_buffer.find_last_not_of("\r\n") + 1));
+    if (!ok) {
+        std::ostringstream oss;
+        oss << "FastCGI backend " << cgi.fcgi_address << " rejected the request, status "
+            << cgi.fcgi_reply.getProtocolStatus();
+        logs(ERROR, oss.str());
+        res.setPage(502, "FastCGI backend rejected the request", true);
+    } else if (!cgi.streaming) {
+        cacheCgiOutput(client);
+        res.setCode(200);
+        res.parseCgiResponse(cgi.output_buffer);
+    }
+
+    // The connection goes back to the pool unless the backend may close it
+    const int fd = cgi.fcgi_fd;
+    poller.remove(fd);
+    untrackFd(fd);
+    cgi.fcgi_fd = -1;
+    if (cgi.fcgi_keepalive > 0 && !cgi.fcgi_reply.hasExtraBytes())
+        fastcgi_pool.release(cgi.fcgi_address, fd, cgi.fcgi_keepalive);
+    else
+        close(fd);
+
+    if (cgi.streaming) {
+        endCgiStream(client_idx, ok);
+        return;
+    }
+    finalizeCgiExecution(client_idx);
+    finishCgiResponse(client_idx, res);
+}
+
+void EventLoop::failFastCgi(int client_idx, const std::string &reason) {
+    Client &client = *clients[client_idx];
+    const ServerConfig &srv = servers[client.getServerIndex()];
+
+    logs(ERROR, "FastCGI backend " + client.getCgiContext().fcgi_address + ": " + reason);
+    if (client.getCgiContext().streaming) {
+        endCgiStream(client_idx, false);
+        return;
+    }
+    finalizeCgiExecution(client_idx);
+
+    Response res(srv.getErrorPagesConfig());
+    res.setPage(502, "FastCGI backend error", true);
+    finishCgiResponse(client_idx, res);
+}
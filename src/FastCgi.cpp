@@ -0,0 +1,230 @@
+#include "FastCgi.hpp"
+#include "Utils.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+static const unsigned char VERSION_1 = 1;
+static const size_t HEADER_LEN = 8;
+static const size_t MAX_CONTENT = 65535;
+static const unsigned char ROLE_RESPONDER = 1;
+static const unsigned char FLAG_KEEP_CONN = 1;
+static const int REQUEST_ID = 1;
+
+static void appendRecord(std::string &out, int type, const char *content, size_t len)
+{
+    const size_t padding = (8 - len % 8) % 8;
+    const char header[HEADER_LEN] = {
+        static_cast<char>(VERSION_1), static_cast<char>(type),
+        static_cast<char>((REQUEST_ID >> 8) & 0xff), static_cast<char>(REQUEST_ID & 0xff),
+        static_cast<char>((len >> 8) & 0xff), static_cast<char>(len & 0xff),
+        static_cast<char>(padding), 0
+    };
+    out.append(header, HEADER_LEN);
+    out.append(content, len);
+    out.append(padding, '\0');
+}
+
+// Splits a stream into records and closes it with an empty one
+static void appendStream(std::string &out, int type, const std::string &data)
+{
+    for (size_t pos = 0; pos < data.size(); pos += MAX_CONTENT)
+        appendRecord(out, type, data.data() + pos, std::min(MAX_CONTENT, data.size() - pos));
+    appendRecord(out, type, "", 0);
+}
+
+static void appendLength(std::string &out, size_t len)
+{
+    if (len < 128) {
+        out += static_cast<char>(len);
+        return;
+    }
+    out += static_cast<char>(((len >> 24) & 0x7f) | 0x80);
+    out += static_cast<char>((len >> 16) & 0xff);
+    out += static_cast<char>((len >> 8) & 0xff);
+    out += static_cast<char>(len & 0xff);
+}
+
+namespace fcgi {
+
+    void encodeRequest(std::string &out, const std::map<std::string, std::string> &params,
+                       const std::string &body, bool keep_conn)
+    {
+        encodeBegin(out, params, keep_conn);
+        appendStream(out, STDIN, body);
+    }
+
+    void encodeBegin(std::string &out, const std::map<std::string, std::string> &params, bool keep_conn)
+    {
+        const char begin[8] = {0, static_cast<char>(ROLE_RESPONDER),
+                               static_cast<char>(keep_conn ? FLAG_KEEP_CONN : 0), 0, 0, 0, 0, 0};
+        appendRecord(out, BEGIN_REQUEST, begin, sizeof(begin));
+
+        std::string pairs;
+        for (std::map<std::string, std::string>::const_iterator it = params.begin(); it != params.end(); ++it) {
+            appendLength(pairs, it->first.size());
+            appendLength(pairs, it->second.size());
+            pairs += it->first;
+            pairs += it->second;
+        }
+        appendStream(out, PARAMS, pairs);
+    }
+
+    void encodeStdin(std::string &out, const char *data, size_t len)
+    {
+        if (len == 0)
+            appendRecord(out, STDIN, "", 0);
+        for (size_t pos = 0; pos < len; pos += MAX_CONTENT)
+            appendRecord(out, STDIN, data + pos, std::min(MAX_CONTENT, len - pos));
+    }
+
+    bool ResponseDecoder::feed(const char *data, size_t len, std::string &out, std::string &err)
+    {
+        pending.append(data, len);
+
+        size_t pos = 0;
+        while (!ended && pending.size() - pos >= HEADER_LEN) {
+            const unsigned char *h = reinterpret_cast<const unsigned char *>(pending.data() + pos);
+            if (h[0] != VERSION_1)
+                return false;
+            const size_t content_len = (h[4] << 8) | h[5];
+            const size_t record_len = HEADER_LEN + content_len + h[6];
+            if (pending.size() - pos < record_len)
+                break;
+
+            // Management records (request id 0) carry nothing we asked for
+            const int request_id = (h[2] << 8) | h[3];
+            const char *content = pending.data() + pos + HEADER_LEN;
+            if (request_id == REQUEST_ID) {
+                if (h[1] == STDOUT)
+                    out.append(content, content_len);
+                else if (h[1] == STDERR)
+                    err.append(content, content_len);
+                else if (h[1] == END_REQUEST) {
+                    if (content_len < 8)
+                        return false;
+                    protocol_status = static_cast<unsigned char>(content[4]);
+                    ended = true;
+                }
+            }
+            pos += record_len;
+        }
+        pending.erase(0, pos);
+        return true;
+    }
+
+    std::string resolveAddress(const std::string &address)
+    {
+        if (address.compare(0, 5, "unix:") == 0) {
+            const std::string path = address.substr(5);
+            if (path.empty() || path.size() >= sizeof(((struct sockaddr_un *)0)->sun_path))
+                return "";
+            return address;
+        }
+
+        const size_t colon = address.rfind(':');
+        if (colon == std::string::npos || colon == 0 || colon + 1 == address.size())
+            return "";
+        const std::string host = address.substr(0, colon);
+        const std::string port = address.substr(colon + 1);
+        if (port.find_first_not_of("0123456789") != std::string::npos || port.size() > 5
+            || std::atoi(port.c_str()) < 1 || std::atoi(port.c_str()) > 65535)
+            return "";
+
+        // Resolved once at startup so the event loop never blocks on DNS
+        struct addrinfo hints;
+        struct addrinfo *res = NULL;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0 || !res)
+            return "";
+        char ip[INET_ADDRSTRLEN];
+        const struct sockaddr_in *sin = reinterpret_cast<struct sockaddr_in *>(res->ai_addr);
+        const bool ok = inet_ntop(AF_INET, &sin->sin_addr, ip, sizeof(ip)) != NULL;
+        freeaddrinfo(res);
+        return ok ? std::string(ip) + ":" + port : "";
+    }
+
+    int connectBackend(const std::string &address)
+    {
+        struct sockaddr_storage storage;
+        socklen_t addr_len;
+        std::memset(&storage, 0, sizeof(storage));
+
+        if (address.compare(0, 5, "unix:") == 0) {
+            struct sockaddr_un *sun = reinterpret_cast<struct sockaddr_un *>(&storage);
+            sun->sun_family = AF_UNIX;
+            std::strncpy(sun->sun_path, address.c_str() + 5, sizeof(sun->sun_path) - 1);
+            addr_len = sizeof(struct sockaddr_un);
+        } else {
+            struct sockaddr_in *sin = reinterpret_cast<struct sockaddr_in *>(&storage);
+            const size_t colon = address.rfind(':');
+            sin->sin_family = AF_INET;
+            sin->sin_port = htons(std::atoi(address.c_str() + colon + 1));
+            if (inet_pton(AF_INET, address.substr(0, colon).c_str(), &sin->sin_addr) != 1)
+                return -1;
+            addr_len = sizeof(struct sockaddr_in);
+        }
+
+        int fd = util::openSocket(storage.ss_family, SOCK_STREAM);
+        if (fd < 0)
+            return -1;
+        if (storage.ss_family == AF_INET) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0
+            || (connect(fd, reinterpret_cast<struct sockaddr *>(&storage), addr_len) < 0 && errno != EINPROGRESS)) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}
+
+FastCgiPool::~FastCgiPool()
+{
+    for (std::map<std::string, std::vector<int> >::iterator it = idle.begin(); it != idle.end(); ++it) {
+        for (size_t i = 0; i < it->second.size(); ++i)
+            close(it->second[i]);
+    }
+}
+
+int FastCgiPool::acquire(const std::string &address)
+{
+    std::vector<int> &fds = idle[address];
+
+    while (!fds.empty()) {
+        int fd = fds.back();
+        fds.pop_back();
+
+        // An idle connection must have nothing to read: EOF or stray bytes mean it's gone
+        char c;
+        if (recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return fd;
+        close(fd);
+    }
+    return fcgi::connectBackend(address);
+}
+
+void FastCgiPool::release(const std::string &address, int fd, size_t max_idle)
+{
+    std::vector<int> &fds = idle[address];
+
+    if (fds.size() >= max_idle) {
+        close(fd);
+        return;
+    }
+    fds.push_back(fd);
+}
@@ -0,0 +1,93 @@
+#include "FileCache.hpp"
+#include "Stats.hpp"
+
+FileCache::FileCache(size_t max_bytes, size_t max_entry, int valid_ms)
+    : max_bytes(max_bytes), max_entry(max_entry), valid_ms(valid_ms), bytes(0)
+{
+    pthread_mutex_init(&lock, NULL);
+}
+
+FileCache::~FileCache()
+{
+    while (!lru.empty())
+        erase(lru.begin());
+    pthread_mutex_destroy(&lock);
+}
+
+void FileCache::erase(EntryList::iterator it)
+{
+    bytes -= it->body.size();
+    stats::add(STAT_FILE_CACHE_ENTRIES, -1);
+    stats::add(STAT_FILE_CACHE_BYTES, -(long)it->body.size());
+    index.erase(it->key);
+    lru.erase(it);
+}
+
+bool FileCache::lookup(const std::string &key, std::string &body, std::string &content_type)
+{
+    pthread_mutex_lock(&lock);
+    std::map<std::string, EntryList::iterator>::iterator found = index.find(key);
+    if (found == index.end())
+    {
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+
+    EntryList::iterator it = found->second;
+    const msec_t now = monotonicMs();
+    if (now - it->validated_at >= (msec_t)valid_ms)
+    {
+        struct stat st;
+        if (::stat(it->key.c_str(), &st) != 0 || st.st_mode != it->mode
+            || st.st_mtime != it->mtime || st.st_size != it->size)
+        {
+            // Changed, gone or no longer readable: the normal path checks it again
+            erase(it);
+            pthread_mutex_unlock(&lock);
+            return false;
+        }
+        it->validated_at = now;
+    }
+
+    lru.splice(lru.begin(), lru, it);
+    body = it->body;
+    content_type = it->content_type;
+    pthread_mutex_unlock(&lock);
+    stats::add(STAT_FILE_CACHE_HITS);
+    return true;
+}
+
+// Called on each miss the caller could read into the cache
+void FileCache::insert(const std::string &key, const struct stat &st,
+                       const std::string &body, const std::string &content_type)
+{
+    stats::add(STAT_FILE_CACHE_MISSES);
+    if (!fits(body.size()))
+        return;
+
+    pthread_mutex_lock(&lock);
+    std::map<std::string, EntryList::iterator>::iterator found = index.find(key);
+    if (found != index.end())
+        erase(found->second);
+
+    while (!lru.empty() && bytes + body.size() > max_bytes)
+    {
+        erase(--lru.end());
+        stats::add(STAT_FILE_CACHE_EVICTIONS);
+    }
+
+    lru.push_front(Entry());
+    Entry &entry = lru.front();
+    entry.key = key;
+    entry.body = body;
+    entry.content_type = content_type;
+    entry.mode = st.st_mode;
+    entry.mtime = st.st_mtime;
+    entry.size = st.st_size;
+    entry.validated_at = monotonicMs();
+    index[key] = lru.begin();
+    bytes += body.size();
+    stats::add(STAT_FILE_CACHE_ENTRIES);
+    stats::add(STAT_FILE_CACHE_BYTES, body.size());
+    pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,156 @@
+#include "FileUpload.hpp"
+#include "HttpException.hpp"
+#include "Logger.hpp"
+#include "Utils.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+FileUpload::FileUpload(const LocationConfig &loc, const std::string &req_path)
+    : fd(-1), pipe_size(0), done(false)
+{
+    pipe_fds[0] = -1;
+    pipe_fds[1] = -1;
+
+    // Dot names stay clear of the temp files of uploads in progress
+    std::string name = req_path.substr(std::min(loc.getUri().size(), req_path.size()));
+    name.erase(0, name.find_first_not_of('/'));
+    if (name.empty() || name[0] == '.')
+        throw HttpException(400, "PUT needs a file name", true);
+
+    const std::string dir = "." + loc.getUploadDir();
+    if (!util::createUploadDir(dir))
+        throw HttpException(500, "Failed to create upload directory", true);
+    path = dir + "/" + util::sanitizeFileName(name);
+
+#ifdef __linux__
+    if (!util::openPipe(pipe_fds)) {
+        logs(ERROR, std::string("pipe() failed: ") + strerror(errno));
+        throw HttpException(500, "Failed to save uploaded file", true);
+    }
+    // A larger pipe means fewer splice() calls; past pipe-max-size the default stays
+    fcntl(pipe_fds[1], F_SETPIPE_SZ, (int)PIPE_SIZE);
+    const int size = fcntl(pipe_fds[1], F_GETPIPE_SZ);
+    pipe_size = size > 0 ? size : 65536;
+#endif
+
+    temp = dir + "/.upload-XXXXXX";
+    fd = util::openTempFile(temp);
+    if (fd < 0) {
+        logs(ERROR, "Failed to create " + temp + ": " + strerror(errno));
+        if (pipe_fds[0] >= 0) {
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+        }
+        throw HttpException(500, "Failed to save uploaded file", true);
+    }
+    fchmod(fd, 0644);
+}
+
+FileUpload::~FileUpload()
+{
+    if (fd >= 0)
+        close(fd);
+    if (pipe_fds[0] >= 0) {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+    }
+    if (!done)
+        unlink(temp.c_str());
+}
+
+ssize_t FileUpload::transfer(int in, off_t *offset, size_t len)
+{
+#ifdef __linux__
+    // The pipe is drained after each splice() into it, so neither side blocks
+    loff_t pos = offset ? *offset : 0;
+    ssize_t n;
+    do
+        n = splice(in, offset ? &pos : NULL, pipe_fds[1], NULL, std::min(len, pipe_size),
+                   SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    while (n < 0 && errno == EINTR);
+    if (n <= 0)
+        return n;
+    drainPipe(n);
+#else
+    char buffer[65536];
+    ssize_t n;
+    do
+        n = offset ? pread(in, buffer, std::min(len, sizeof(buffer)), *offset)
+                   : read(in, buffer, std::min(len, sizeof(buffer)));
+    while (n < 0 && errno == EINTR);
+    if (n <= 0)
+        return n;
+    writeFile(buffer, n);
+#endif
+    if (offset)
+        *offset += n;
+    return n;
+}
+
+void FileUpload::processBody(const Request &req)
+{
+    if (req.getBodyFd() < 0)
+        return writeFile(req.getBody().data(), req.getBody().size());
+
+    for (off_t offset = 0; offset < (off_t)req.getBodySize(); ) {
+        if (transfer(req.getBodyFd(), &offset, req.getBodySize() - offset) <= 0) {
+            logs(ERROR, std::string("Cannot read request body file: ") + strerror(errno));
+            throw HttpException(500, "Failed to save uploaded file", true);
+        }
+    }
+}
+
+bool FileUpload::finish()
+{
+    struct stat st;
+    const bool created = stat(path.c_str(), &st) != 0;
+    if (rename(temp.c_str(), path.c_str()) != 0) {
+        logs(ERROR, "Failed to save uploaded file " + path + ": " + strerror(errno));
+        throw HttpException(500, "Failed to save uploaded file", true);
+    }
+    done = true;
+    logs(INFO, "File uploaded successfully: " + path);
+    return created;
+}
+
+// For bytes already in memory, like the part of the body read with the headers
+void FileUpload::writeFile(const char *data, size_t len)
+{
+    for (size_t written = 0; written < len; )
+    {
+        const ssize_t n = write(fd, data + written, len - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            logs(ERROR, "Failed to write " + temp + ": " + strerror(errno));
+            throw HttpException(500, "Failed to save uploaded file", true);
+        }
+        written += n;
+    }
+}
+
+void FileUpload::drainPipe(size_t len)
+{
+#ifdef __linux__
+    while (len > 0)
+    {
+        const ssize_t n = splice(pipe_fds[0], NULL, fd, NULL, len, SPLICE_F_MOVE);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            logs(ERROR, "Failed to write " + temp + ": " + strerror(errno));
+            throw HttpException(500, "Failed to save uploaded file", true);
+        }
+        len -= n;
+    }
+#else
+    (void)len;
+#endif
+}
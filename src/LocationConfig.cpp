@@ -1,7 +1,13 @@
 #include "LocationConfig.hpp"
 #include <algorithm>
 
-LocationConfig::LocationConfig() : has_return(false), autoindex(false), client_max_body_size(1048576)
+LocationConfig::LocationConfig() : has_return(false), autoindex(false), fastcgi_keepalive(8),
+                                   cgi_pool_min(0), cgi_pool_max(0), cgi_pool_idle_ms(60000),
+                                   cgi_max_concurrent(0), cgi_queue_size(0), cgi_coalesce(false),
+                                   cgi_cache_size(0), cgi_cache_valid_ms(1000), cgi_cache_stale_ms(0), cgi_cache(NULL),
+                                   client_max_body_size(1048576),
+                                   file_cache_size(0), file_cache_max_entry(256 * 1024), file_cache_valid_ms(1000),
+                                   file_cache(NULL), stub_status(false)
 {
     allowed_methods.push_back("GET");
     allowed_methods.push_back("POST");
@@ -20,6 +26,22 @@ std::ostream &operator<<(std::ostream &os, const std::vector<LocationConfig>& ob
         os << " -- Upload dir: " << obj[i].getUploadDir() << "\n";
         os << " -- Autoindex: " << obj[i].getAutoindex() << "\n";
 		os << " -- CGI extension: " << obj[i].getCgiExtension() << "\n";
+        const std::map<std::string, std::string> &interpreters = obj[i].getCgiInterpreters();
+        for (std::map<std::string, std::string>::const_iterator it = interpreters.begin(); it != interpreters.end(); ++it)
+            os << " -- CGI interpreter: " << it->first << " " << it->second << "\n";
+        if (!obj[i].getFastCgiPass().empty())
+            os << " -- FastCGI: " << obj[i].getFastCgiPass() << " keepalive " << obj[i].getFastCgiKeepalive() << "\n";
+        if (obj[i].getCgiPoolMax() > 0)
+            os << " -- CGI pool: " << obj[i].getCgiPoolMin() << "-" << obj[i].getCgiPoolMax()
+               << " idle " << obj[i].getCgiPoolIdle() << "ms\n";
+        if (obj[i].getCgiMaxConcurrent() > 0)
+            os << " -- CGI limit: " << obj[i].getCgiMaxConcurrent() << " running, "
+               << obj[i].getCgiQueueSize() << " queued\n";
+        if (obj[i].getCgiCoalesce())
+            os << " -- CGI coalescing: on\n";
+        if (obj[i].getCgiCacheSize() > 0)
+            os << " -- CGI cache: " << obj[i].getCgiCacheSize() << " bytes, valid "
+               << obj[i].getCgiCacheValid() << "ms, stale " << obj[i].getCgiCacheStale() << "ms\n";
     }
     return (os);
 }
@@ -35,13 +57,13 @@ std::ostream &operator<<(std::ostream &os, const std::vector<std::string>& obj)
     return (os);
 }
 
-bool LocationConfig::isCgiRequest(std::string &uri) {
-    size_t pos = uri.rfind('.');
-    if (pos != std::string::npos) {
-        std::string extension = uri.substr(pos);
-        return (extension == cgi_extension);
-    }
-    return (false);
+// Interpreter for the script at `path`, or NULL if its extension is not run as CGI here
+const std::string *LocationConfig::findCgiInterpreter(const std::string &path) const {
+    size_t pos = path.rfind('.');
+    if (pos == std::string::npos || path.find('/', pos) != std::string::npos)
+        return (NULL);
+    std::map<std::string, std::string>::const_iterator it = cgi_interpreters.find(path.substr(pos));
+    return (it == cgi_interpreters.end() ? NULL : &it->second);
 }
 
 bool LocationConfig::isMethodAllowed(const std::string &method) const {
@@ -1,12 +1,14 @@
 #include "Logger.hpp"
 #include <iostream>
+#include <sstream>
 #include <ctime>
 
 static std::string timestamp() {
     std::time_t now = std::time(0);
-    std::tm *ltm = std::localtime(&now);
+    std::tm ltm;
+    localtime_r(&now, &ltm);
     char buf[32];
-    std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", ltm);
+    std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &ltm);
     return std::string(buf);
 }
 
@@ -19,6 +21,9 @@ void logs(LogLevel level, const std::string &msg) {
         case ERROR:  tag = "ERROR"; color = "\033[31m"; break; // red
     }
 
+    // Format the whole line first so lines from different threads don't interleave
+    std::ostringstream line;
+    line << "[" << color << tag << reset << "]" << " " << timestamp() << " " << color << msg << reset << "\n";
     std::ostream& out = (level == ERROR) ? std::cerr : std::cout;
-    out << "[" << color << tag << reset << "]" << " " << timestamp() << " " << color << msg << reset << std::endl;
+    out << line.str() << std::flush;
 }
\ No newline at end of file
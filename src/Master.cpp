@@ -0,0 +1,105 @@
+#include "Master.hpp"
+#include "Logger.hpp"
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+Master::Master(Config &config) : config(config) {}
+
+bool Master::spawnWorker()
+{
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        logs(ERROR, std::string("fork failed for worker: ") + strerror(errno));
+        return false;
+    }
+
+    if (pid == 0)
+    {
+        bool ok = config.setupServer() && config.run();
+        std::exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    workers[pid] = time(NULL);
+    std::ostringstream oss;
+    oss << "Started worker pid=" << pid;
+    logs(INFO, oss.str());
+    return true;
+}
+
+void Master::stopWorkers()
+{
+    for (std::map<pid_t, time_t>::iterator it = workers.begin(); it != workers.end(); ++it)
+        kill(it->first, SIGINT);
+}
+
+bool Master::run()
+{
+    // Bind once in the master so a bad config fails before any worker is forked
+    if (!config.setupServer())
+        return false;
+    config.closeListeners();
+
+    // main() installed the stop handler, so waitpid() returns EINTR on shutdown
+    for (int i = 0; i < config.getWorkerProcesses(); ++i)
+    {
+        if (!spawnWorker())
+        {
+            stopWorkers();
+            g_stop_signal = 1;
+            break;
+        }
+    }
+
+    bool ok = !g_stop_signal;
+    bool stopping = false;
+    while (!workers.empty())
+    {
+        if (g_stop_signal && !stopping)
+        {
+            logs(INFO, "Signal received, stopping workers...");
+            stopWorkers();
+            stopping = true;
+        }
+
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        std::map<pid_t, time_t>::iterator it = workers.find(pid);
+        if (it == workers.end())
+            continue;
+        const time_t started = it->second;
+        workers.erase(it);
+
+        if (stopping || (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS))
+            continue;
+
+        std::ostringstream oss;
+        oss << "Worker pid=" << pid << " died";
+        if (WIFSIGNALED(status))
+            oss << " (signal " << WTERMSIG(status) << ")";
+        else
+            oss << " (exit status " << WEXITSTATUS(status) << ")";
+        logs(ERROR, oss.str());
+
+        // A worker that cannot survive its first second would just crash-loop
+        if (time(NULL) - started < 1 || !spawnWorker())
+        {
+            ok = false;
+            g_stop_signal = 1;
+        }
+    }
+    return ok;
+}
@@ -0,0 +1,188 @@
+#include "MultipartUpload.hpp"
+#include "HttpException.hpp"
+#include "Logger.hpp"
+#include "Utils.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// input_ starts with the CRLF that the first delimiter may go without
+MultipartUpload::MultipartUpload(const LocationConfig &loc, const std::string *content_type)
+    : dir("." + loc.getUploadDir()), max_body(loc.getMaxBodySize() > 0 ? loc.getMaxBodySize() : 0),
+      received(0), state(PREAMBLE), input_("\r\n"), kept(2), scanned(0), fd(-1)
+{
+    if (!content_type)
+        throw HttpException(400, "Missing Content-Type header", true);
+    const std::string boundary = util::extractBoundary(*content_type);
+    if (boundary.size() <= 2)
+        throw HttpException(400, "Bad Request", true);
+    delimiter = "\r\n" + boundary;
+
+    if (!util::createUploadDir(dir))
+        throw HttpException(500, "Failed to create upload directory", true);
+}
+
+MultipartUpload::~MultipartUpload()
+{
+    if (fd >= 0)
+        close(fd);
+    for (size_t i = 0; i < files.size(); ++i)
+        unlink(files[i].first.c_str());
+}
+
+void MultipartUpload::process()
+{
+    received += input_.size() - kept;
+    if (max_body && received > max_body)
+        throw HttpException(413, "Payload Too Large", true);
+
+    bool progress = true;
+    while (progress)
+    {
+        progress = false;
+        switch (state)
+        {
+            case PREAMBLE:
+            case PART_BODY: {
+                const size_t found = input_.find(delimiter, scanned);
+                if (found == std::string::npos) {
+                    // Only the tail may still turn out to be the start of a delimiter
+                    scanned = input_.size() < delimiter.size() ? 0 : input_.size() - delimiter.size() + 1;
+                    if (scanned >= WRITE_SIZE)
+                        writePart(scanned);
+                    break;
+                }
+                writePart(found);
+                input_.erase(0, delimiter.size());
+                scanned = 0;
+                if (state == PART_BODY)
+                    endPart();
+                state = DELIMITER_END;
+                progress = true;
+                break;
+            }
+            case DELIMITER_END:
+                // Transport padding may follow a delimiter (RFC 2046 5.1.1)
+                input_.erase(0, input_.find_first_not_of(" \t"));
+                if (input_.size() < 2)
+                    break;
+                if (input_.compare(0, 2, "--") == 0)
+                    state = EPILOGUE;
+                else if (input_.compare(0, 2, "\r\n") == 0)
+                    state = PART_HEADERS;
+                else
+                    throw HttpException(400, "Malformed multipart delimiter", true);
+                input_.erase(0, 2);
+                progress = true;
+                break;
+            case PART_HEADERS: {
+                if (input_.size() < 2)
+                    break;
+                // A part may come without headers; its body then starts right away
+                const size_t end = input_.compare(0, 2, "\r\n") == 0 ? 0 : input_.find("\r\n\r\n");
+                if (end == std::string::npos) {
+                    if (input_.size() > MAX_PART_HEADERS)
+                        throw HttpException(400, "Multipart part headers too large", true);
+                    break;
+                }
+                const size_t body = end == 0 ? 2 : end + 4;
+                startPart(input_.substr(0, body));
+                input_.erase(0, body);
+                state = PART_BODY;
+                progress = true;
+                break;
+            }
+            case EPILOGUE:
+                input_.clear();
+                break;
+        }
+    }
+    kept = input_.size();
+}
+
+void MultipartUpload::processBody(const Request &req)
+{
+    if (req.getBodyFd() < 0) {
+        input_.append(req.getBody());
+        return process();
+    }
+
+    char buffer[WRITE_SIZE];
+    for (off_t offset = 0; offset < (off_t)req.getBodySize(); ) {
+        const ssize_t n = pread(req.getBodyFd(), buffer, sizeof(buffer), offset);
+        if (n <= 0) {
+            logs(ERROR, std::string("Cannot read request body file: ") + strerror(errno));
+            throw HttpException(500, "Failed to save uploaded file", true);
+        }
+        offset += n;
+        input_.append(buffer, n);
+        process();
+    }
+}
+
+void MultipartUpload::finish()
+{
+    if (state != EPILOGUE)
+        throw HttpException(400, "Multipart body ends before its closing delimiter", true);
+    if (files.empty())
+        throw HttpException(400, "Filename missing in multipart part", true);
+
+    while (!files.empty())
+    {
+        const std::string &path = files.front().second;
+        if (rename(files.front().first.c_str(), path.c_str()) != 0) {
+            logs(ERROR, "Failed to save uploaded file " + path + ": " + strerror(errno));
+            throw HttpException(500, "Failed to save uploaded file", true);
+        }
+        logs(INFO, "File uploaded successfully: " + path);
+        files.erase(files.begin());
+    }
+}
+
+void MultipartUpload::startPart(const std::string &headers)
+{
+    const std::string filename = util::extractFilename(headers);
+    if (filename.empty())
+        return;
+    if (util::extractContentType(headers).empty())
+        throw HttpException(400, "Content-Type missing in multipart part", true);
+
+    // Created next to its final name, so finish() only has to rename it
+    std::string temp = dir + "/.upload-XXXXXX";
+    fd = util::openTempFile(temp);
+    if (fd < 0) {
+        logs(ERROR, "Failed to create " + temp + ": " + strerror(errno));
+        throw HttpException(500, "Failed to save uploaded file", true);
+    }
+    fchmod(fd, 0644);
+    files.push_back(std::make_pair(temp, dir + "/" + util::sanitizeFileName(filename)));
+}
+
+// Hands the first `len` input bytes to the current part, or drops them
+void MultipartUpload::writePart(size_t len)
+{
+    for (size_t done = 0; fd >= 0 && done < len; )
+    {
+        const ssize_t n = write(fd, input_.data() + done, len - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            logs(ERROR, "Failed to write " + files.back().first + ": " + strerror(errno));
+            throw HttpException(500, "Failed to save uploaded file", true);
+        }
+        done += n;
+    }
+    input_.erase(0, len);
+    scanned = scanned > len ? scanned - len : 0;
+}
+
+void MultipartUpload::endPart()
+{
+    if (fd >= 0)
+        close(fd);
+    fd = -1;
+}
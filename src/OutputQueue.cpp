@@ -0,0 +1,127 @@
+#include "OutputQueue.hpp"
+#include "Utils.hpp"
+
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+
+// Memory segments gathered into one writev()
+static const int MAX_IOV = 16;
+
+OutputQueue::OutputQueue() : memory_bytes(0) {}
+
+OutputQueue::~OutputQueue()
+{
+    clear();
+}
+
+void OutputQueue::pushData(std::string &data)
+{
+    if (data.empty())
+        return;
+    segments.push_back(Segment());
+    segments.back().data.swap(data);
+    memory_bytes += segments.back().data.size();
+}
+
+void OutputQueue::pushFile(int fd, off_t offset, off_t length)
+{
+    if (fd < 0)
+        return;
+    if (length <= 0)
+    {
+        close(fd);
+        return;
+    }
+    segments.push_back(Segment());
+    segments.back().fd = fd;
+    segments.back().offset = offset;
+    segments.back().end = offset + length;
+}
+
+void OutputQueue::popFront()
+{
+    Segment &seg = segments.front();
+    if (seg.fd >= 0)
+        close(seg.fd);
+    else
+        memory_bytes -= seg.data.size();
+    segments.pop_front();
+}
+
+void OutputQueue::clear()
+{
+    while (!segments.empty())
+        popFront();
+}
+
+// One writev() over the leading run of memory segments
+ssize_t OutputQueue::writeMemory(int sock)
+{
+    struct iovec iov[MAX_IOV];
+    int count = 0;
+    for (std::deque<Segment>::iterator it = segments.begin();
+         it != segments.end() && it->fd < 0 && count < MAX_IOV; ++it, ++count)
+    {
+        iov[count].iov_base = const_cast<char *>(it->data.data()) + it->pos;
+        iov[count].iov_len = it->data.size() - it->pos;
+    }
+
+    ssize_t written = writev(sock, iov, count);
+    if (written <= 0)
+        return written;
+
+    size_t left = written;
+    while (left > 0)
+    {
+        Segment &seg = segments.front();
+        const size_t avail = seg.data.size() - seg.pos;
+        if (left < avail)
+        {
+            seg.pos += left;
+            break;
+        }
+        left -= avail;
+        popFront();
+    }
+    return written;
+}
+
+ssize_t OutputQueue::writeFile(int sock, size_t budget)
+{
+    Segment &seg = segments.front();
+    const off_t remaining = seg.end - seg.offset;
+    const size_t chunk = (remaining < (off_t)budget) ? (size_t)remaining : budget;
+
+    ssize_t sent = util::sendFileChunk(sock, seg.fd, seg.offset, chunk);
+    if (sent == 0)
+    {
+        // The file shrank under us; the promised Content-Length can't be met
+        errno = EIO;
+        return -1;
+    }
+    if (sent > 0 && seg.offset >= seg.end)
+        popFront();
+    return sent;
+}
+
+ssize_t OutputQueue::flush(int sock)
+{
+    size_t total = 0;
+
+    while (!segments.empty() && total < FLUSH_BUDGET)
+    {
+        const bool is_file = segments.front().fd >= 0;
+        ssize_t n = is_file ? writeFile(sock, FLUSH_BUDGET - total) : writeMemory(sock);
+        if (n < 0)
+        {
+            if (total > 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                break;
+            return -1;
+        }
+        if (n == 0)
+            break;
+        total += n;
+    }
+    return total;
+}
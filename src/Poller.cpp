@@ -0,0 +1,190 @@
+#include "Poller.hpp"
+#include "Logger.hpp"
+
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+# include <sys/epoll.h>
+#endif
+
+Poller::Poller() : backend(POLL), epoll_fd(-1), fd_count(0) {}
+
+Poller::~Poller()
+{
+    if (epoll_fd >= 0)
+        close(epoll_fd);
+}
+
+bool Poller::init(Backend b)
+{
+    backend = b;
+    if (backend == POLL)
+        return true;
+#ifdef __linux__
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+    {
+        logs(ERROR, std::string("epoll_create1 failed: ") + strerror(errno));
+        return false;
+    }
+    return true;
+#else
+    logs(ERROR, "epoll backend is not available on this platform");
+    return false;
+#endif
+}
+
+#ifdef __linux__
+static uint32_t toEpoll(short events)
+{
+    uint32_t ev = 0;
+    if (events & POLLIN)
+        ev |= EPOLLIN;
+    if (events & POLLOUT)
+        ev |= EPOLLOUT;
+    return ev;
+}
+
+static short fromEpoll(uint32_t ev)
+{
+    short revents = 0;
+    if (ev & EPOLLIN)
+        revents |= POLLIN;
+    if (ev & EPOLLOUT)
+        revents |= POLLOUT;
+    if (ev & EPOLLERR)
+        revents |= POLLERR;
+    if (ev & EPOLLHUP)
+        revents |= POLLHUP;
+    return revents;
+}
+#endif
+
+bool Poller::add(int fd, short events)
+{
+    if (fd < 0)
+        return false;
+#ifdef __linux__
+    if (backend == EPOLL)
+    {
+        struct epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = toEpoll(events);
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+            return false;
+        fd_count++;
+        return true;
+    }
+#endif
+    if ((size_t)fd >= fd_index.size())
+        fd_index.resize(fd + 1, -1);
+    if (fd_index[fd] >= 0)
+        return modify(fd, events);
+    pollfd p = {fd, events, 0};
+    fd_index[fd] = poll_fds.size();
+    poll_fds.push_back(p);
+    fd_count++;
+    return true;
+}
+
+bool Poller::modify(int fd, short events)
+{
+    if (fd < 0)
+        return false;
+#ifdef __linux__
+    if (backend == EPOLL)
+    {
+        struct epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = toEpoll(events);
+        ev.data.fd = fd;
+        return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == 0;
+    }
+#endif
+    if ((size_t)fd >= fd_index.size() || fd_index[fd] < 0)
+        return false;
+    poll_fds[fd_index[fd]].events = events;
+    return true;
+}
+
+void Poller::remove(int fd)
+{
+    if (fd < 0)
+        return;
+#ifdef __linux__
+    if (backend == EPOLL)
+    {
+        struct epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, &ev) == 0 && fd_count > 0)
+            fd_count--;
+        return;
+    }
+#endif
+    if ((size_t)fd >= fd_index.size() || fd_index[fd] < 0)
+        return;
+
+    // swap-remove keeps the pollfd array dense without shifting
+    size_t pos = fd_index[fd];
+    size_t last = poll_fds.size() - 1;
+    if (pos != last)
+    {
+        poll_fds[pos] = poll_fds[last];
+        fd_index[poll_fds[pos].fd] = pos;
+    }
+    poll_fds.pop_back();
+    fd_index[fd] = -1;
+    fd_count--;
+}
+
+int Poller::wait(int timeout_ms, std::vector<PollEvent> &ready)
+{
+    ready.clear();
+#ifdef __linux__
+    if (backend == EPOLL)
+    {
+        const int max_events = 256;
+        struct epoll_event events[max_events];
+        int n = epoll_wait(epoll_fd, events, max_events, timeout_ms);
+        if (n < 0)
+            return -1;
+        for (int i = 0; i < n; ++i)
+        {
+            PollEvent e = {events[i].data.fd, fromEpoll(events[i].events)};
+            ready.push_back(e);
+        }
+        return n;
+    }
+#endif
+    int n = poll(poll_fds.empty() ? NULL : &poll_fds[0], poll_fds.size(), timeout_ms);
+    if (n <= 0)
+        return n;
+    for (size_t i = 0; i < poll_fds.size() && (int)ready.size() < n; ++i)
+    {
+        if (poll_fds[i].revents)
+        {
+            PollEvent e = {poll_fds[i].fd, poll_fds[i].revents};
+            ready.push_back(e);
+        }
+    }
+    return n;
+}
+
+bool parseBackendName(const std::string &name, Poller::Backend &out)
+{
+    if (name == "poll")
+        out = Poller::POLL;
+    else if (name == "epoll")
+        out = Poller::EPOLL;
+    else
+        return false;
+    return true;
+}
+
+const char *backendName(Poller::Backend b)
+{
+    return (b == Poller::EPOLL) ? "epoll" : "poll";
+}
@@ -0,0 +1,278 @@
+#include "RequestParser.hpp"
+#include "HttpException.hpp"
+#include "Utils.hpp"
+#include "Logger.hpp"
+
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <sstream>
+#include <algorithm>
+
+RequestParser::RequestParser() : state(REQUEST_LINE), header_bytes(0), body_limit(0),
+                                 body_received(0), remaining(0), body_sink(NULL),
+                                 body_buffer(0), body_fd(-1), body_accepted(false) {}
+
+RequestParser::~RequestParser()
+{
+    closeBodyFile();
+}
+
+void RequestParser::reset()
+{
+    state = REQUEST_LINE;
+    body_limit = 0;
+    request = Request();
+    line.clear();
+    header_bytes = 0;
+    body_received = 0;
+    remaining = 0;
+    body_sink = NULL;
+    body_accepted = false;
+}
+
+// The body, which may be large, is moved rather than copied
+void RequestParser::take(Request &out)
+{
+    std::string body;
+    request.swapBody(body);
+    out = request;
+    out.swapBody(body);
+    reset();
+}
+
+size_t RequestParser::feed(const char *data, size_t len)
+{
+    size_t pos = 0;
+
+    while (pos < len && state != COMPLETE && !awaitingBody())
+    {
+        if (state == BODY || state == CHUNK_DATA)
+        {
+            const size_t take = std::min(remaining, len - pos);
+            if (body_sink)
+                body_sink->append(data + pos, take);
+            else if (request.getBodyFd() >= 0 || (body_buffer && request.getBody().size() + take > body_buffer))
+                spillBody(data + pos, take);
+            else
+                request.appendBody(data + pos, take);
+            pos += take;
+            remaining -= take;
+            if (remaining == 0)
+                state = (state == BODY) ? COMPLETE : CHUNK_DATA_END;
+            continue;
+        }
+
+        // Line-oriented states: only the new bytes are scanned for the terminator
+        const char *nl = static_cast<const char *>(std::memchr(data + pos, '\n', len - pos));
+        const size_t take = nl ? (size_t)(nl - (data + pos)) + 1 : len - pos;
+        line.append(data + pos, take);
+        pos += take;
+
+        if (state == REQUEST_LINE && line.size() > MAX_REQUEST_LINE)
+            throw HttpException(414, "URI Too Long", true);
+        if (state != REQUEST_LINE && line.size() > MAX_HEADER_BYTES)
+            throw HttpException(431, "Request Header Fields Too Large", true);
+        if (!nl)
+            break;
+
+        line.erase(line.size() - 1);
+        if (!line.empty() && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+        handleLine();
+        line.clear();
+    }
+    return pos;
+}
+
+void RequestParser::acceptBody(size_t limit)
+{
+    body_limit = limit;
+    if (state == BODY && body_limit && remaining > body_limit)
+        throw HttpException(413, "Payload Too Large", true);
+    body_accepted = true;
+}
+
+void RequestParser::skipBody(size_t len)
+{
+    remaining -= std::min(len, remaining);
+    if (remaining == 0)
+        state = COMPLETE;
+}
+
+void RequestParser::handleLine()
+{
+    switch (state)
+    {
+        case REQUEST_LINE:
+            // Stray CRLFs between keep-alive requests are allowed (RFC 9112 2.2)
+            if (!line.empty())
+                parseRequestLine();
+            break;
+        case HEADER_LINE:
+            header_bytes += line.size() + 2;
+            if (header_bytes > MAX_HEADER_BYTES)
+                throw HttpException(431, "Request Header Fields Too Large", true);
+            if (line.empty())
+                finishHeaders();
+            else
+                parseHeaderLine();
+            break;
+        case CHUNK_SIZE:
+            parseChunkSize();
+            break;
+        case CHUNK_DATA_END:
+            if (!line.empty())
+                throw HttpException(400, "Missing CRLF after chunk data", true);
+            state = CHUNK_SIZE;
+            break;
+        case CHUNK_TRAILER:
+            if (line.empty())
+                state = COMPLETE;
+            break;
+        default:
+            break;
+    }
+}
+
+void RequestParser::parseRequestLine()
+{
+    // Whoever still needs the previous body's file has its own descriptor by now
+    closeBodyFile();
+
+    std::istringstream iss(line);
+    std::string method, path, version;
+
+    if (!(iss >> method >> path >> version))
+        throw HttpException(400, "Malformed request line", true);
+
+    request.setMethod(method);
+    if (method != "GET" && method != "POST" && method != "DELETE" && method != "PUT")
+        throw HttpException(405, "Method Not Allowed", true);
+
+    std::string query;
+    size_t qpos = path.find('?');
+    if (qpos != std::string::npos) {
+        query = path.substr(qpos + 1);
+        path = path.substr(0, qpos);
+    }
+
+    std::string cleanPath = util::normalizePath(path);
+    if (cleanPath.empty())
+        cleanPath = "/";
+    if (!util::isValidPath(cleanPath))
+        throw HttpException(400, "Bad Request", true);
+
+    request.setReqPath(cleanPath);
+    request.setQueryString(query);
+    if (version != "HTTP/1.0" && version != "HTTP/1.1")
+        throw HttpException(400, "Bad Request: unsupported HTTP version", true);
+    request.setVersion(version);
+
+    header_bytes = line.size() + 2;
+    state = HEADER_LINE;
+}
+
+void RequestParser::parseHeaderLine()
+{
+    std::string::size_type pos = line.find(':');
+    if (pos == std::string::npos)
+        throw HttpException(400, "Malformed header line", true);
+
+    std::string key = line.substr(0, pos);
+    std::string value = line.substr(pos + 1);
+
+    key.erase(0, key.find_first_not_of(" \t"));
+    key.erase(key.find_last_not_of(" \t") + 1);
+    value.erase(0, value.find_first_not_of(" \t"));
+    value.erase(value.find_last_not_of(" \t") + 1);
+
+    if (key.empty())
+        throw HttpException(400, "Bad Request", true);
+
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+    request.setHeader(key, value);
+}
+
+// Picks the body framing once the blank line is seen
+void RequestParser::finishHeaders()
+{
+    const std::string *te = request.findHeader("transfer-encoding");
+    if (te) {
+        if (*te != "chunked")
+            throw HttpException(400, "Unsupported Transfer-Encoding", true);
+        state = CHUNK_SIZE;
+        return;
+    }
+
+    const std::string *cl = request.findHeader("content-length");
+    if (!cl) {
+        state = COMPLETE;
+        return;
+    }
+    if (cl->empty() || cl->size() > 18 || cl->find_first_not_of("0123456789") != std::string::npos)
+        throw HttpException(400, "Bad Request", true);
+
+    remaining = std::strtoul(cl->c_str(), NULL, 10);
+    body_received = remaining;
+    state = (remaining == 0) ? COMPLETE : BODY;
+}
+
+void RequestParser::parseChunkSize()
+{
+    std::string size = line.substr(0, line.find(';'));
+    size.erase(0, size.find_first_not_of(" \t"));
+    size.erase(size.find_last_not_of(" \t") + 1);
+    if (size.empty() || size.size() > 15 || size.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+        throw HttpException(400, "Invalid chunk size", true);
+
+    remaining = std::strtoul(size.c_str(), NULL, 16);
+    body_received += remaining;
+    if (body_limit && body_received > body_limit)
+        throw HttpException(413, "Payload Too Large", true);
+    state = (remaining == 0) ? CHUNK_TRAILER : CHUNK_DATA;
+}
+
+static void writeBodyFile(int fd, const char *data, size_t len)
+{
+    for (size_t done = 0; done < len; ) {
+        const ssize_t n = write(fd, data + done, len - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            logs(ERROR, std::string("Cannot write request body file: ") + strerror(errno));
+            throw HttpException(500, "Internal Server Error", true);
+        }
+        done += n;
+    }
+}
+
+// Moves the body to a temp file once it outgrows the buffer, then appends to it
+void RequestParser::spillBody(const char *data, size_t len)
+{
+    if (request.getBodyFd() < 0) {
+        closeBodyFile();
+        std::string path = temp_path + "/webserv-body-XXXXXX";
+        body_fd = util::openTempFile(path);
+        if (body_fd < 0) {
+            logs(ERROR, "Cannot create request body file in " + temp_path + ": " + strerror(errno));
+            throw HttpException(500, "Internal Server Error", true);
+        }
+        unlink(path.c_str());
+
+        std::string head;
+        request.swapBody(head);
+        writeBodyFile(body_fd, head.data(), head.size());
+        request.setBodyFile(body_fd, head.size());
+    }
+    writeBodyFile(body_fd, data, len);
+    request.setBodyFile(body_fd, request.getBodySize() + len);
+}
+
+void RequestParser::closeBodyFile()
+{
+    if (body_fd >= 0)
+        close(body_fd);
+    body_fd = -1;
+}
@@ -5,15 +5,24 @@
 #include "Config.hpp"
 #include "HttpException.hpp"
 #include "Utils.hpp"
+#include "OutputQueue.hpp"
+#include "FileCache.hpp"
+#include "Stats.hpp"
+#include "MultipartUpload.hpp"
+#include "FileUpload.hpp"
 
 #include <dirent.h>
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
 
 static const std::pair<const char *, const char *> mimeArray[] = {
     std::pair<const char *, const char *>(".html", "text/html"),
@@ -29,42 +38,64 @@ static const std::pair<const char *, const char *> mimeArray[] = {
     std::pair<const char *, const char *>(".json", "application/json"),
     std::pair<const char *, const char *>(".svg", "image/svg+xml")};
 
-Response::Response() : fullPath_(".") {}
+Response::Response() : statusCode_(200), statusMessage_("OK"), fullPath_("."), bodyFd_(-1), bodyFileSize_(0) {}
 
 Response::Response(std::map<int, std::string> error_pages)
-    : statusCode_(200), statusMessage_("OK"), fullPath_("."), error_pages_config(error_pages) {}
+    : statusCode_(200), statusMessage_("OK"), fullPath_("."), error_pages_config(error_pages),
+      bodyFd_(-1), bodyFileSize_(0) {}
 
 Response::Response(std::map<int, std::string> error_pages, int code, const std::string &message, bool error)
-    : statusCode_(200), statusMessage_("OK"), fullPath_("."), error_pages_config(error_pages)
+    : statusCode_(200), statusMessage_("OK"), fullPath_("."), error_pages_config(error_pages),
+      bodyFd_(-1), bodyFileSize_(0)
 {
     setVersion("HTTP/1.1");
     setPage(code, message, error);
     setHeader("Connection", "close");
 }
 
+Response::~Response()
+{
+    if (bodyFd_ >= 0)
+        close(bodyFd_);
+}
+
 void Response::handleGet(const LocationConfig &loc) {
 
+    // A cached file skips the stat() below; its entry is dropped once it
+    // changes or loses its read permission
+    FileCache *cache = loc.getFileCache();
+    if (cache && cache->lookup(fullPath_, body_, contentType_)) {
+        setHeader(HEADER_CONTENT_TYPE, contentType_);
+        return;
+    }
+
     struct stat file_stat;
     if (!util::fileExists(fullPath_, file_stat))
         return;
 
-    if (S_ISDIR(file_stat.st_mode))
+    const bool directory = S_ISDIR(file_stat.st_mode);
+    if (directory)
     {
         std::vector<std::string> index_files = loc.getIndexFiles();
-        for (std::vector<std::string>::const_iterator it = index_files.begin(); it != index_files.end(); ++it)
+        std::vector<std::string>::const_iterator it;
+        for (it = index_files.begin(); it != index_files.end(); ++it)
         {
             std::string candidate = fullPath_ + "/" + *it;
             struct stat s;
             if (::stat(candidate.c_str(), &s) == 0 && S_ISREG(s.st_mode))
             {
                 fullPath_ = candidate;
-                return handleGet(loc);
+                file_stat = s;
+                break;
             }
         }
-        if (loc.getAutoindex())
-            return (generateAutoIndex());
-        else
-            throw HttpException(404, "File not found", true);
+        if (it == index_files.end())
+        {
+            if (loc.getAutoindex())
+                return (generateAutoIndex());
+            else
+                throw HttpException(404, "File not found", true);
+        }
     }
 
     if (!S_ISREG(file_stat.st_mode))
@@ -72,9 +103,20 @@ void Response::handleGet(const LocationConfig &loc) {
     if (!(file_stat.st_mode & S_IROTH))
         throw HttpException(403, "Permission denied", true);
 
-    readFileIntoBody(fullPath_);
-    //setHeader(HEADER_CONTENT_LENGTH, util::intToString(body_.size()));
-    setHeader(HEADER_CONTENT_TYPE, getContentType(fullPath_));
+    // A directory is cached under the index file it resolved to just now, so
+    // adding an index file listed earlier takes effect at once
+    if (directory && cache && cache->lookup(fullPath_, body_, contentType_)) {
+        setHeader(HEADER_CONTENT_TYPE, contentType_);
+        return;
+    }
+
+    contentType_ = getContentType(fullPath_);
+    if (cache && cache->fits(file_stat.st_size)) {
+        readFileIntoBody(fullPath_);
+        cache->insert(fullPath_, file_stat, body_, contentType_);
+    } else
+        openBodyFile(fullPath_, file_stat.st_size);
+    setHeader(HEADER_CONTENT_TYPE, contentType_);
     return;
 
 }
@@ -95,6 +137,21 @@ void Response:: readFileIntoBody(const std::string &fileName) {
     body_ = ss.str();
 }
 
+// Static files are not read here: the event loop streams them from the fd
+void Response::openBodyFile(const std::string &fileName, off_t size) {
+    int fd = open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT)
+            throw HttpException(404, "Not Found", true);
+        throw HttpException(500, "Server error: unable to open file.", true);
+    }
+    if (bodyFd_ >= 0)
+        close(bodyFd_);
+    bodyFd_ = fd;
+    bodyFileSize_ = size;
+    body_.clear();
+}
+
 void Response::generateAutoIndex(void) {
     std::string uri = reqPath_;
     std::string path = fullPath_;
@@ -150,31 +207,37 @@ void Response::handlePost(const Request &reqObj, LocationConfig loc)
     if (loc.getUploadDir().empty())
         throw std::runtime_error("Config error: No upload_path specified in location " + loc.getUri());
 
-    if ((int)reqObj.getBody().size() > reqObj.getMaxBodySize())
+    // The event loop usually wrote the files out while the body came in
+    if (reqObj.getUpload()) {
+        reqObj.getUpload()->finish();
+        return setPage(201, "File uploaded successfully", false);
+    }
+
+    if ((int)reqObj.getBodySize() > reqObj.getMaxBodySize())
         throw HttpException(413, "Payload Too Large", true);
 
-    std::string reqPath = reqObj.getReqPath();
-    // if (reqPath != "/upload" && reqPath.find("/upload/") != 0)
-    //     throw HttpException(405, "Method Not Allowed", true);
+    MultipartUpload upload(loc, reqObj.findHeader(HEADER_CONTENT_TYPE));
+    upload.processBody(reqObj);
+    upload.finish();
+    setPage(201, "File uploaded successfully", false);
+}
 
-    if (!reqObj.findHeader(HEADER_CONTENT_TYPE))
-        throw HttpException(400, "Missing Content-Type header", true);
+// 201 for a new file, 204 for one replaced (RFC 9110 9.3.4)
+void Response::handlePut(const Request &reqObj, const LocationConfig &loc)
+{
+    bool created;
+    // The event loop usually spliced the body into the file while it came in
+    if (reqObj.getFileUpload())
+        created = reqObj.getFileUpload()->finish();
     else {
-        std::string boundary = util::extractBoundary(*reqObj.findHeader(HEADER_CONTENT_TYPE));
-        if (boundary.empty())
-            throw HttpException (400, "Bad Request", true);
-        struct util::MultipartPart mp_struct = util::parseMultipartBody(reqObj.getBody(), boundary);
-
-        std::string uploadFullPath = "." + loc.getUploadDir();
-        if (!util::createUploadDir(uploadFullPath))
-            throw HttpException(500, "Failed to create upload directory", true);
-        std::string safeFilename = util::sanitizeFileName(mp_struct.filename);
-        std::string filePath = uploadFullPath + "/" + safeFilename;
-
-        if (!util::saveFile(filePath, mp_struct.content))
-            throw HttpException(500, "Failed to save uploaded file", true);
-        setPage(201, "File uploaded successfully", false);
+        FileUpload upload(loc, reqObj.getReqPath());
+        upload.processBody(reqObj);
+        created = upload.finish();
     }
+    if (created)
+        setPage(201, "File created", false);
+    else
+        setPage(204, "No content. File \"" + reqObj.getReqPath() + "\" replaced.", false);
 }
 
 void Response::uploadFile(const std::string &uploadFullPath)
@@ -213,54 +276,75 @@ void Response::handleDelete(const Request &reqObj) {
     setPage(204, "No content. File \"" + filename_ + "\" deleted successfully.", false);
 }
 
-std::string Response::writeResponseString() const
+std::string Response::writeHeaders() const
 {
     std::ostringstream res;
-    std::map<std::string, std::string> headers = getHeaders();
     res << "HTTP/1.1 " << statusCode_ << " " << statusMessage_ << "\r\n";
-    for (std::map<std::string, std::string>::iterator it = headers.begin(); it != headers.end(); ++it)
+    for (std::map<std::string, std::string>::const_iterator it = headers_.begin(); it != headers_.end(); ++it)
         res << it->first << ": " << it->second << "\r\n";
     res << "\r\n";
-    res << body_;
 
     return (res.str());
 }
 
-void Response::setCode(const int code)
+// Moves the response onto a connection's output queue: the header block, then
+// the body, either the in-memory one or the open file. Leaves this Response empty.
+void Response::queueInto(OutputQueue &out)
 {
-    statusCode_ = code;
+    std::string head = writeHeaders();
+    out.pushData(head);
+    out.pushData(body_);
+    if (bodyFd_ >= 0)
+        out.pushFile(bodyFd_, 0, bodyFileSize_);
+    bodyFd_ = -1;
+}
 
-    static std::map<int, std::string> codeToMessage;
-    if (codeToMessage.empty())
-    {
-        codeToMessage[200] = "OK";
-        codeToMessage[201] = "Created";
-        codeToMessage[204] = "No Content";
-        codeToMessage[301] = "Moved Permanently";
-        codeToMessage[302] = "Found";
-        codeToMessage[303] = "See Other";
-        codeToMessage[307] = "Temporary Redirect";
-        codeToMessage[308] = "Permanent Redirect";
-        codeToMessage[400] = "Bad Request";
-        codeToMessage[403] = "Forbidden";
-        codeToMessage[404] = "Not Found";
-        codeToMessage[408] = "Request Timeout";
-        codeToMessage[405] = "Method Not Allowed";
-        codeToMessage[411] = "Length Required";
-        codeToMessage[413] = "Payload too large";
-        codeToMessage[414] = "URI too long";
-        codeToMessage[500] = "Internal Server Error";
-    }
+// Built once; lookups below must not insert, since event loop threads share it
+static std::map<int, std::string> initStatusMessages()
+{
+    std::map<int, std::string> m;
+    m[200] = "OK";
+    m[201] = "Created";
+    m[204] = "No Content";
+    m[301] = "Moved Permanently";
+    m[302] = "Found";
+    m[303] = "See Other";
+    m[307] = "Temporary Redirect";
+    m[308] = "Permanent Redirect";
+    m[400] = "Bad Request";
+    m[403] = "Forbidden";
+    m[404] = "Not Found";
+    m[408] = "Request Timeout";
+    m[405] = "Method Not Allowed";
+    m[411] = "Length Required";
+    m[413] = "Payload too large";
+    m[414] = "URI too long";
+    m[417] = "Expectation Failed";
+    m[431] = "Request Header Fields Too Large";
+    m[500] = "Internal Server Error";
+    m[502] = "Bad Gateway";
+    m[503] = "Service Unavailable";
+    m[504] = "Gateway Timeout";
+    return m;
+}
 
-    statusMessage_ = codeToMessage[code];
-    if (statusMessage_.empty())
-        statusMessage_ = "Unknown Status";
+void Response::setCode(const int code)
+{
+    statusCode_ = code;
 
+    static const std::map<int, std::string> codeToMessage = initStatusMessages();
+    std::map<int, std::string>::const_iterator it = codeToMessage.find(code);
+    statusMessage_ = (it != codeToMessage.end()) ? it->second : "Unknown Status";
 }
 
 void Response::setPage(const int code, const std::string &message, bool error)
 {
     setCode(code);
+    // A 204 ends at its header block (RFC 9110 15.3.5)
+    if (code == 204) {
+        body_.clear();
+        return;
+    }
 
     std::string errorPagePath = error_pages_config[code];
     if (errorPagePath.empty())
@@ -297,7 +381,7 @@ void Response::setFullPath(const std::string &reqPath) {
 //     return (out);
 // }
 
-std::string Response::buildResponse(const Request &reqObj, const LocationConfig &locConfig)
+void Response::buildResponse(const Request &reqObj, const LocationConfig &locConfig)
 {
     this->setVersion(reqObj.getVersion());
     this->setFullPath(reqObj.getFullPath());
@@ -305,7 +389,7 @@ std::string Response::buildResponse(const Request &reqObj, const LocationConfig
 
     if (reqObj.getReqPath().size() > MAX_URI_LENGTH) {
         this->setPage(414, "URI Too Long", true);
-        return (this->writeResponseString());
+        return;
     }
 
     if (!locConfig.isMethodAllowed(reqObj.getMethod())) {
@@ -318,17 +402,23 @@ std::string Response::buildResponse(const Request &reqObj, const LocationConfig
                 allowHeader += ", ";
         }
         this->setHeader("Allow", allowHeader);
-        return (this->writeResponseString());
+        return;
     }
 
     if (!locConfig.getReturnTarget().empty()) {
         handleRedirect(locConfig);
+    } else if (locConfig.getStubStatus() && !reqObj.getMethod().compare("GET")) {
+        setCode(200);
+        body_ = stats::render();
+        setHeader(HEADER_CONTENT_TYPE, "text/plain");
     } else if (!reqObj.getMethod().compare("GET")) {
         handleGet(locConfig);
     } else if (!reqObj.getMethod().compare("POST")) {
         handlePost(reqObj, locConfig);
     } else if (!reqObj.getMethod().compare("DELETE")) {
         handleDelete(reqObj);
+    } else if (!reqObj.getMethod().compare("PUT")) {
+        handlePut(reqObj, locConfig);
     } else
         throw HttpException(501, "Method not implemented", true);
 
@@ -347,43 +437,61 @@ std::string Response::buildResponse(const Request &reqObj, const LocationConfig
         want_close = (connection != "keep-alive"); // default is close
 
     setHeader("Connection", want_close ? "close" : "keep-alive");
-    setHeader(HEADER_CONTENT_LENGTH, util::intToString(body_.size()));
-    return (writeResponseString());
+    if (statusCode_ == 204)
+        return;
+    if (bodyFd_ >= 0) {
+        std::ostringstream len;
+        len << bodyFileSize_;
+        setHeader(HEADER_CONTENT_LENGTH, len.str());
+    } else
+        setHeader(HEADER_CONTENT_LENGTH, util::intToString(body_.size()));
 }
 
-void Response::parseCgiResponse(const std::string &cgiOutput) {
-    std::istringstream stream(cgiOutput);
-    std::string line;
-    bool headersDone = false;
-    std::ostringstream body;
-    while (std::getline(stream, line)) {
+// Reads the header block a CGI script starts its output with (RFC 3875 6.2).
+// Returns the offset of the body, or npos while the blank line is still missing.
+size_t Response::parseCgiHeaders(const std::string &cgiOutput) {
+    size_t pos = 0;
+    while (true) {
+        const size_t nl = cgiOutput.find('\n', pos);
+        if (nl == std::string::npos)
+            return std::string::npos;
+        std::string line = cgiOutput.substr(pos, nl - pos);
+        pos = nl + 1;
         // Remove trailing \r if present
         if (!line.empty() && line[line.size() - 1] == '\r')
             line.erase(line.size() - 1);
+        if (line.empty())
+            return pos;
 
-        if (!headersDone) {
-            if (line.empty()) {
-                headersDone = true;
-                continue;
-            }
-            size_t colon = line.find(":");
-            if (colon != std::string::npos) {
-                std::string key = line.substr(0, colon);
-                std::string value = line.substr(colon + 1);
-                value.erase(0, value.find_first_not_of(" \t"));
-                setHeader(key, value);
-            }
-        } else {
-            body << line << "\n";
+        size_t colon = line.find(":");
+        if (colon == std::string::npos)
+            continue;
+        std::string key = line.substr(0, colon);
+        std::string value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        std::string lower = key;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        // CGI scripts pick the status with a Status header (RFC 3875 6.3.3)
+        if (lower == "status") {
+            if (std::atoi(value.c_str()) >= 100)
+                setCode(std::atoi(value.c_str()));
+        } else if (lower == "content-length") {
+            setHeader(HEADER_CONTENT_LENGTH, value);
+        } else if (lower != "transfer-encoding" && lower != "connection") {
+            // Framing is ours to choose, whatever the script sent
+            setHeader(key, value);
         }
     }
-    std::string b = body.str();
-    if (!b.empty() && b[b.size()-1] == '\n') b.erase(b.size()-1);
+}
 
-    setBody(b);
+void Response::parseCgiResponse(const std::string &cgiOutput) {
+    size_t body = parseCgiHeaders(cgiOutput);
+    if (body == std::string::npos)
+        body = cgiOutput.size();
+    setBody(cgiOutput.substr(body));
 
-    if (!findHeader("Content-Length")) {
-        setHeader("Content-Length", util::intToString(b.size()));
+    if (!findHeader(HEADER_CONTENT_LENGTH)) {
+        setHeader(HEADER_CONTENT_LENGTH, util::intToString(body_.size()));
     }
 }
 
@@ -1,8 +1,26 @@
 #include "ServerConfig.hpp"
 
 ServerConfig::ServerConfig() : listen_port(-1), host(""), error_pages_config(),
-                                client_max_body_size(1048576), locations()
-{};
+                                client_max_body_size(1048576), client_body_buffer_size(16384),
+                                client_body_temp_path("/tmp"), locations()
+{
+    timeouts_ms[TIMEOUT_HEADER] = 60000;
+    timeouts_ms[TIMEOUT_BODY] = 60000;
+    timeouts_ms[TIMEOUT_SEND] = 60000;
+    timeouts_ms[TIMEOUT_KEEPALIVE] = 60000;
+    timeouts_ms[TIMEOUT_CGI] = 60000;
+    timeouts_ms[TIMEOUT_CGI_IDLE] = 5000;
+    timeouts_ms[TIMEOUT_CGI_QUEUE] = 10000;
+};
+
+const char *timeoutDirective(TimeoutKind kind)
+{
+    static const char *names[TIMEOUT_KINDS] = {
+        "header_timeout", "body_timeout", "send_timeout", "keepalive_timeout", "cgi_timeout",
+        "cgi_idle_timeout", "cgi_queue_timeout"
+    };
+    return names[kind];
+}
 
 const std::string &ServerConfig::getErrorPage(int code) const {
     std::map<int, std::string>::const_iterator it = error_pages_config.find(code);
@@ -20,6 +38,10 @@ std::ostream &operator<<(std::ostream &os, const ServerConfig &obj) {
     os << "\n- Host: " << obj.getHost();
     os << "\n- Error Pages: " << obj.getErrorPagesConfig();
     os << "\n- Client Max Body Size: " << obj.getMaxBodySize();
+    os << "\n- Client Body Buffer Size: " << obj.getBodyBufferSize();
+    os << "\n- Client Body Temp Path: " << obj.getBodyTempPath();
+    for (int k = 0; k < TIMEOUT_KINDS; ++k)
+        os << "\n- " << timeoutDirective(static_cast<TimeoutKind>(k)) << ": " << obj.getTimeout(static_cast<TimeoutKind>(k)) << "ms";
     os << "\n- Locations: " << obj.getLocations() << std::endl;
     return os;
 };
@@ -9,16 +9,17 @@
 #include <cstdio> 
 
 
-ServerSocket::ServerSocket() : fd(-1), port(0), isSetup(false) {
+ServerSocket::ServerSocket() : fd(-1), port(0), isSetup(false), reusePort(false) {
 	std::memset(&address, 0, sizeof(address));
 }
 
 ServerSocket::~ServerSocket() {}
 
-bool ServerSocket::setupServerSocket(int port, std::string host) {
+bool ServerSocket::setupServerSocket(int port, std::string host, bool reusePort) {
 	
 	this->port = port;
 	this->host = host;
+	this->reusePort = reusePort;
 	if (!createSocket()) return false;
 	if (!configureSocket()) return false;
 	if (!bindSocket()) return false;
@@ -28,6 +29,13 @@ bool ServerSocket::setupServerSocket(int port, std::string host) {
 	return true;
 }
 
+void ServerSocket::closeSocket() {
+	if (fd >= 0)
+		close(fd);
+	fd = -1;
+	isSetup = false;
+}
+
 bool ServerSocket::createSocket() {
 	fd = socket(AF_INET, SOCK_STREAM, 0);
 	if (fd < 0) {
@@ -39,7 +47,8 @@ bool ServerSocket::createSocket() {
 };
 
 bool ServerSocket::configureSocket() {
-	if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
+	// Not for CGI processes to inherit
+	if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
 		perror("fcntl failed");
 		return false;
 	}
@@ -50,6 +59,19 @@ bool ServerSocket::configureSocket() {
 		return false;
 	}
 
+	// Each worker process binds its own listener; the kernel spreads accepts across them
+	if (reusePort) {
+#ifdef SO_REUSEPORT
+		if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &option, sizeof(option)) < 0) {
+			perror("setsockopt SO_REUSEPORT failed");
+			return false;
+		}
+#else
+		perror("SO_REUSEPORT is not supported");
+		return false;
+#endif
+	}
+
 	return true;
 };
 
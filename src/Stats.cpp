@@ -0,0 +1,49 @@
+#include "Stats.hpp"
+
+#include <sstream>
+
+static long counters[STAT_COUNT];
+
+static const char *names[STAT_COUNT] = {
+    "file_cache_hits",
+    "file_cache_misses",
+    "file_cache_evictions",
+    "file_cache_entries",
+    "file_cache_bytes",
+    "cgi_pool_hits",
+    "cgi_pool_misses",
+    "cgi_pool_idle",
+    "cgi_queue_depth",
+    "cgi_queue_admitted",
+    "cgi_queue_wait_ms",
+    "cgi_queue_rejected",
+    "cgi_coalesced",
+    "cgi_cache_hits",
+    "cgi_cache_stale",
+    "cgi_cache_misses",
+    "cgi_cache_evictions",
+    "cgi_cache_entries",
+    "cgi_cache_bytes"
+};
+
+namespace stats {
+
+    void add(StatCounter counter, long delta)
+    {
+        __sync_fetch_and_add(&counters[counter], delta);
+    }
+
+    long get(StatCounter counter)
+    {
+        return __sync_fetch_and_add(&counters[counter], 0);
+    }
+
+    // One "name value" pair per line
+    std::string render()
+    {
+        std::ostringstream out;
+        for (int i = 0; i < STAT_COUNT; ++i)
+            out << names[i] << " " << get(static_cast<StatCounter>(i)) << "\n";
+        return out.str();
+    }
+}
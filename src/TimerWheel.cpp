@@ -0,0 +1,160 @@
+#include "TimerWheel.hpp"
+
+#include <ctime>
+
+msec_t monotonicMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (msec_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+TimerWheel::TimerWheel() : now_tick(0), count(0)
+{
+    for (int level = 0; level < LEVELS; ++level)
+        slots[level].assign(slotCount(level), NULL);
+}
+
+int TimerWheel::shift(int level)
+{
+    return (level == 0) ? 0 : L0_BITS + (level - 1) * LN_BITS;
+}
+
+int TimerWheel::slotCount(int level)
+{
+    return (level == 0) ? (1 << L0_BITS) : (1 << LN_BITS);
+}
+
+void TimerWheel::reset(msec_t now_ms)
+{
+    now_tick = now_ms / TICK_MS;
+}
+
+// Put the timer in the lowest level whose span still reaches its expiry
+void TimerWheel::link(Timer &t)
+{
+    const msec_t max_delta = ((msec_t)1 << shift(LEVELS)) - 1;
+    if (t.expires - now_tick > max_delta)
+        t.expires = now_tick + max_delta;
+
+    const msec_t delta = t.expires - now_tick;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= ((msec_t)1 << shift(level + 1)))
+        level++;
+
+    Timer *&head = slots[level][(t.expires >> shift(level)) & (slotCount(level) - 1)];
+    t.prev = NULL;
+    t.next = head;
+    if (head)
+        head->prev = &t;
+    head = &t;
+    t.bucket = &head;
+}
+
+void TimerWheel::schedule(Timer &t, msec_t expires_ms)
+{
+    cancel(t);
+    t.expires = (expires_ms + TICK_MS - 1) / TICK_MS;
+    if (t.expires <= now_tick)
+        t.expires = now_tick + 1;
+    link(t);
+    count++;
+}
+
+void TimerWheel::cancel(Timer &t)
+{
+    if (!t.bucket)
+        return;
+    if (t.prev)
+        t.prev->next = t.next;
+    else
+        *t.bucket = t.next;
+    if (t.next)
+        t.next->prev = t.prev;
+    t.prev = NULL;
+    t.next = NULL;
+    t.bucket = NULL;
+    count--;
+}
+
+// Re-file the current slot of `level`; its timers now fit in lower levels
+void TimerWheel::cascade(int level)
+{
+    Timer *&head = slots[level][(now_tick >> shift(level)) & (slotCount(level) - 1)];
+    Timer *t = head;
+    head = NULL;
+    while (t)
+    {
+        Timer *next = t->next;
+        link(*t);
+        t = next;
+    }
+}
+
+void TimerWheel::advance(msec_t now_ms, std::vector<TimerEvent> &fired)
+{
+    const msec_t target = now_ms / TICK_MS;
+
+    while (now_tick < target)
+    {
+        if (count == 0)
+        {
+            now_tick = target;
+            break;
+        }
+        now_tick++;
+
+        const int idx = now_tick & (slotCount(0) - 1);
+        if (idx == 0)
+        {
+            for (int level = 1; level < LEVELS; ++level)
+            {
+                cascade(level);
+                if (((now_tick >> shift(level)) & (slotCount(level) - 1)) != 0)
+                    break;
+            }
+        }
+
+        Timer *t = slots[0][idx];
+        slots[0][idx] = NULL;
+        while (t)
+        {
+            Timer *next = t->next;
+            t->prev = NULL;
+            t->next = NULL;
+            t->bucket = NULL;
+            count--;
+            TimerEvent ev = {t->owner, t->kind};
+            fired.push_back(ev);
+            t = next;
+        }
+    }
+}
+
+int TimerWheel::nextTimeout(msec_t now_ms) const
+{
+    if (count == 0)
+        return -1;
+
+    // First non-empty slot on each level; an upper-level slot only needs a
+    // wakeup when it is cascaded, at the start of its range.
+    msec_t best = (msec_t)1 << shift(LEVELS);
+    for (int level = 0; level < LEVELS; ++level)
+    {
+        const msec_t cur = now_tick >> shift(level);
+        const int n = slotCount(level);
+        for (int j = 1; j <= n; ++j)
+        {
+            if (slots[level][(cur + j) & (n - 1)])
+            {
+                const msec_t ticks = ((cur + j) << shift(level)) - now_tick;
+                if (ticks < best)
+                    best = ticks;
+                break;
+            }
+        }
+    }
+
+    const msec_t due = (now_tick + best) * TICK_MS;
+    return (due > now_ms) ? (int)(due - now_ms) : 0;
+}
@@ -11,6 +11,22 @@
 #include <cerrno>
 #include <algorithm>
 #include <cstring>
+#include <unistd.h>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+
+// posix_spawn() can set the child's working directory since glibc 2.29
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+# define SPAWN_CAN_CHDIR 1
+#endif
+
+#ifdef __linux__
+# include <sys/sendfile.h>
+# include <sys/syscall.h>
+#endif
 
 const char *HEADER_CONTENT_TYPE = "content-type";
 
@@ -94,22 +110,6 @@ namespace util {
         throw HttpException(500, "Internal server error while accessing file", true);
     }
 
-    bool saveFile(const std::string &filePath, const std::string &fileContent)
-    {
-        std::ofstream outFile(filePath.c_str(), std::ios::binary);
-        std::string msg;
-        if (!outFile)
-        {
-            logs(ERROR, "Failed to open file: " + filePath);
-            return false;
-        }
-        outFile.write(fileContent.c_str(), fileContent.size());
-        outFile.close();
-        msg = "File uploaded successfully: " + filePath;
-        logs(INFO, msg);
-        return true;
-    }
-
     bool createUploadDir(const std::string &uploadFullPath)
     {
         if (mkdir(uploadFullPath.c_str(), 0755) == -1)
@@ -180,7 +180,13 @@ namespace util {
         size_t pos = rawValue.find("boundary=");
         std::string boundary = "--";
         if (pos != std::string::npos)
-            boundary.append(rawValue.substr(pos + 9));
+        {
+            std::string value = rawValue.substr(pos + 9, rawValue.find(';', pos) - (pos + 9));
+            value.erase(value.find_last_not_of(" \t") + 1);
+            if (value.size() >= 2 && value[0] == '"' && value[value.size() - 1] == '"')
+                value = value.substr(1, value.size() - 2);
+            boundary.append(value);
+        }
         return (boundary);
     }
 
@@ -206,84 +212,171 @@ namespace util {
         return ("");
     }
 
-    std::string parseChunkedBody(std::string &raw, int maxBodySize)
+    // Sends up to `count` bytes of `fd` from `offset` without copying them
+    // through userspace where the kernel allows it; advances `offset`.
+    ssize_t sendFileChunk(int sock, int fd, off_t &offset, size_t count)
     {
-        //body_.clear();
-        std::string body;
-        std::string::size_type pos = 0;
-        std::size_t totalSize = 0;
+#ifdef __linux__
+        return sendfile(sock, fd, &offset, count);
+#else
+        char buf[65536];
+        ssize_t n = pread(fd, buf, std::min(count, sizeof(buf)), offset);
+        if (n <= 0)
+            return n;
+        ssize_t sent = send(sock, buf, n, 0);
+        if (sent > 0)
+            offset += sent;
+        return sent;
+#endif
+    }
 
-        while (true)
+    // Resolves a command the way execvp() would: names containing a '/' are
+    // taken as they are, others are searched for in $PATH. Returns "" unless
+    // the result is an executable regular file.
+    std::string findExecutable(const std::string &name)
+    {
+        struct stat st;
+
+        if (name.empty())
+            return "";
+        if (name.find('/') != std::string::npos)
+            return (stat(name.c_str(), &st) == 0 && S_ISREG(st.st_mode) && access(name.c_str(), X_OK) == 0)
+                   ? name : "";
+
+        const char *env = std::getenv("PATH");
+        std::string path = env ? env : "/usr/local/bin:/usr/bin:/bin";
+        size_t start = 0;
+        while (start <= path.size())
         {
-            std::string::size_type endline = raw.find("\r\n", pos);
-            if (endline == std::string::npos)
-                throw HttpException(400, "Malformed chunk size line", true);
-
-            std::string sizeStr = raw.substr(pos, endline - pos);
-            std::istringstream iss(sizeStr);
-            std::size_t chunkSize = 0;
-            iss >> std::hex >> chunkSize;
-            if (iss.fail())
-                throw HttpException(400, "Invalid chunk size", true);
-
-            pos = endline + 2; // move past "\r\n"
-
-            if (chunkSize == 0)
-            {
-                std::string::size_type trailerEnd = raw.find("\r\n", pos);
-                if (trailerEnd == std::string::npos)
-                    throw HttpException(400, "Missing CRLF after last chunk", true);
-                raw.erase(0, trailerEnd + 2);
-                return (body);
-            }
-
-            totalSize += chunkSize;
-            if ((int)totalSize > maxBodySize)
-                 throw HttpException(413, "Payload Too Large", true);
-
-            if (raw.size() < pos + chunkSize + 2)
-                throw HttpException(400, "Incomplete chunk data", true);
-
-            body.append(raw, pos, chunkSize);
-
-            pos += chunkSize;
-
-            if (raw.substr(pos, 2) != "\r\n")
-                throw HttpException(400, "Missing CRLF after chunk data", true);
-            pos += 2;
+            size_t end = path.find(':', start);
+            if (end == std::string::npos)
+                end = path.size();
+            std::string dir = path.substr(start, end - start);
+            std::string candidate = (dir.empty() ? "." : dir) + "/" + name;
+            if (stat(candidate.c_str(), &st) == 0 && S_ISREG(st.st_mode) && access(candidate.c_str(), X_OK) == 0)
+                return candidate;
+            start = end + 1;
         }
+        return "";
     }
 
-    MultipartPart parseMultipartBody(const std::string &rawBody, const std::string &boundary)
+    // An fd that polls readable once `pid` has exited (Linux 5.3+), close-on-exec;
+    // -1 where pidfds are unavailable
+    int openPidFd(pid_t pid)
     {
-        MultipartPart part;
-
-        std::string body = rawBody;
-        size_t start = body.find(boundary);
-        if (start != std::string::npos)
-            body = body.substr(start + boundary.length() + 2);
-
-        std::string closingBoundary = boundary + "--";
-        size_t end = body.rfind(closingBoundary);
-        if (end != std::string::npos)
-            body = body.substr(0, end - 2);
-
-        size_t headerEnd = body.find("\r\n\r\n");
-        if (headerEnd == std::string::npos)
-            throw HttpException(400, "Malformed multipart part", true);
+#if defined(__linux__) && defined(SYS_pidfd_open)
+        return syscall(SYS_pidfd_open, pid, 0);
+#else
+        (void)pid;
+        return -1;
+#endif
+    }
 
-        std::string headers = body.substr(0, headerEnd);
-        part.content = body.substr(headerEnd + 4);
+    // The fds below are close-on-exec from the start: with several event loop
+    // threads, a CGI may be spawned between their creation and an fcntl()
+    bool openPipe(int fds[2])
+    {
+#ifdef __linux__
+        return pipe2(fds, O_CLOEXEC) == 0;
+#else
+        if (pipe(fds) < 0)
+            return false;
+        fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+        return true;
+#endif
+    }
 
-        part.filename = extractFilename(headers);
-        if (part.filename.empty())
-            throw HttpException(400, "Filename missing in multipart part", true);
+    int openSocket(int domain, int type)
+    {
+#ifdef __linux__
+        return socket(domain, type | SOCK_CLOEXEC, 0);
+#else
+        int fd = socket(domain, type, 0);
+        if (fd >= 0)
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        return fd;
+#endif
+    }
 
-        part.contentType = extractContentType(headers);
-        if (part.contentType.empty())
-            throw HttpException(400, "Content-Type missing in multipart part", true);
+    // mkstemp() with the name's XXXXXX filled in
+    int openTempFile(std::string &path_template)
+    {
+#ifdef __linux__
+        return mkostemp(&path_template[0], O_CLOEXEC);
+#else
+        int fd = mkstemp(&path_template[0]);
+        if (fd >= 0)
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        return fd;
+#endif
+    }
 
-        return part;
+    int acceptClient(int fd, struct sockaddr *addr, socklen_t *len)
+    {
+#ifdef __linux__
+        return accept4(fd, addr, len, SOCK_CLOEXEC);
+#else
+        int client = accept(fd, addr, len);
+        if (client >= 0)
+            fcntl(client, F_SETFD, FD_CLOEXEC);
+        return client;
+#endif
     }
 
-}
\ No newline at end of file
+    pid_t spawnProcess(const char *path, char *const argv[], char *const envp[], const int fds[3], const char *dir)
+    {
+        sigset_t none, defaults;
+        sigemptyset(&none);
+        sigemptyset(&defaults);
+        sigaddset(&defaults, SIGPIPE);
+        sigaddset(&defaults, SIGINT);
+        sigaddset(&defaults, SIGTERM);
+
+#ifndef SPAWN_CAN_CHDIR
+        if (dir) {
+            pid_t pid = fork();
+            if (pid != 0)
+                return pid;
+            for (int i = 0; i < 3; ++i) {
+                if (fds[i] >= 0)
+                    dup2(fds[i], i);
+            }
+            for (int sig = 1; sig < NSIG; ++sig) {
+                if (sigismember(&defaults, sig) == 1)
+                    signal(sig, SIG_DFL);
+            }
+            sigprocmask(SIG_SETMASK, &none, NULL);
+            if (chdir(dir) == 0)
+                execve(path, argv, envp);
+            _exit(127);
+        }
+#endif
+
+        posix_spawn_file_actions_t actions;
+        posix_spawnattr_t attr;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawnattr_init(&attr);
+        for (int i = 0; i < 3; ++i) {
+            if (fds[i] >= 0)
+                posix_spawn_file_actions_adddup2(&actions, fds[i], i);
+        }
+#ifdef SPAWN_CAN_CHDIR
+        if (dir)
+            posix_spawn_file_actions_addchdir_np(&actions, dir);
+#endif
+        posix_spawnattr_setsigmask(&attr, &none);
+        posix_spawnattr_setsigdefault(&attr, &defaults);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+        pid_t pid = -1;
+        const int err = posix_spawn(&pid, path, &actions, &attr, argv, envp);
+        posix_spawn_file_actions_destroy(&actions);
+        posix_spawnattr_destroy(&attr);
+        if (err != 0) {
+            errno = err;
+            return -1;
+        }
+        return pid;
+    }
+}
@@ -1,13 +1,21 @@
 #include "Config.hpp"
-#include <signal.h>
+#include "Master.hpp"
+#include "Logger.hpp"
+#include "CgiPool.hpp"
 
-void signal_handler(int sig) {
-	(void)sig;
-}
+#include <cstdlib>
+#include <string>
+#include <signal.h>
 
 int main(int ac, char *av[])
 {
-    signal(SIGINT, signal_handler);
+    // A pre-spawned CGI worker: wait for one request, then become its CGI process
+    if (ac == 3 && std::string(av[1]) == CGI_WORKER_FLAG)
+        return runCgiWorker(std::atoi(av[2]));
+    CgiPool::setExecutable(av[0]);
+
+    installStopHandler();
+    signal(SIGPIPE, SIG_IGN); // a peer that went away must surface as EPIPE, not kill us
 
     try
     {
@@ -21,6 +29,14 @@ int main(int ac, char *av[])
         Config config(configfile);
 
         //std::cout << config << std::endl;
+        if (config.getWorkerProcesses() > 1) {
+            Master master(config);
+            if (!master.run()) {
+                throw std::runtime_error("Server failed to run.");
+            };
+            return 0;
+        }
+
         if (!config.setupServer()) {
             throw std::runtime_error("Failed to set server up.");
         };
@@ -0,0 +1,75 @@
+#!/bin/bash
+# FastCGI Test Script
+# Starts tests/fastcgi_responder.py on the socket /fastcgi of config/simple.conf
+# passes to, then checks requests against a live and a dead backend.
+# Usage: ./test_fastcgi.sh [host] [port]
+
+HOST=${1:-127.0.0.1}
+PORT=${2:-8080}
+BASE_URL="http://$HOST:$PORT/fastcgi"
+SOCKET="/tmp/webserv_fastcgi.sock"
+
+# Colors
+GREEN="\033[32m"
+RED="\033[31m"
+NC="\033[0m"
+
+PASS_COUNT=0
+FAIL_COUNT=0
+
+print_result() {
+    local actual=$1
+    local expected=$2
+    local test_name=$3
+
+    if [[ "$actual" == "$expected" ]]; then
+        echo -e "✅ $test_name -> ${GREEN}PASS${NC} (got $actual)"
+        ((PASS_COUNT++))
+    else
+        echo -e "❌ $test_name -> ${RED}FAIL${NC} (got $actual, expected $expected)"
+        ((FAIL_COUNT++))
+    fi
+}
+
+echo "🧪 FastCGI Testing Suite"
+echo "========================"
+
+python3 "$(dirname "$0")/tests/fastcgi_responder.py" "$SOCKET" &
+RESPONDER=$!
+for _ in 1 2 3 4 5 6 7 8 9 10; do
+    [[ -S "$SOCKET" ]] && break
+    sleep 0.2
+done
+
+# Test 1: One request through the backend
+echo "🔹 1. Testing FastCGI GET"
+BODY=$(curl -s -w " %{http_code}" "$BASE_URL/app")
+print_result "${BODY##* }" "200" "FastCGI GET status"
+print_result "$(echo "$BODY" | grep -o 'method=GET')" "method=GET" "FastCGI GET answered by the backend"
+
+# Test 2: Request body forwarded as FCGI_STDIN
+echo "🔹 2. Testing FastCGI POST"
+BODY=$(curl -s -X POST -d "0123456789" "$BASE_URL/app")
+print_result "$(echo "$BODY" | grep -o 'body=[0-9]*')" "body=10" "FastCGI POST body"
+
+# Test 3: Two requests on one client connection share the kept-alive backend connection
+echo "🔹 3. Testing FastCGI backend keep-alive"
+CONNS=$(curl -s "$BASE_URL/a" -o /dev/stdout "$BASE_URL/b" | grep -o 'conn=[0-9]*')
+FIRST=$(echo "$CONNS" | head -1)
+SECOND=$(echo "$CONNS" | tail -1)
+print_result "$(echo "$CONNS" | wc -l | tr -d ' ') $SECOND" "2 $FIRST" "FastCGI backend connection reused"
+
+# Test 4: A backend that is gone is a bad gateway
+echo "🔹 4. Testing dead FastCGI backend"
+kill "$RESPONDER"
+wait "$RESPONDER" 2>/dev/null
+rm -f "$SOCKET"
+CODE=$(curl -s -o /dev/null -w "%{http_code}" "$BASE_URL/app")
+print_result "$CODE" "502" "Dead FastCGI backend"
+
+echo ""
+echo "========================================"
+echo -e "📊 Final Results: ${GREEN}$PASS_COUNT PASSED${NC}, ${RED}$FAIL_COUNT FAILED${NC}"
+echo "========================================"
+
+[[ $FAIL_COUNT -eq 0 ]]
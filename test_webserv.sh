@@ -147,6 +147,42 @@ else
     echo -e "❌ Upload /upload -> ${RED}FAIL${NC} (got $CODE, expected 200/201)"
 fi
 
+# --------------------
+# PUT /upload/file, then again to replace it
+head -c 1500000 /dev/urandom > put_test.bin
+CODE=$(curl -s -o /dev/null -w "%{http_code}" -T put_test.bin $BASE_URL/upload/put_test.bin)
+print_result $CODE 201 "PUT /upload/put_test.bin"
+CODE=$(curl -s -o /dev/null -w "%{http_code}" -T put_test.bin $BASE_URL/upload/put_test.bin)
+print_result $CODE 204 "PUT /upload/put_test.bin (replace)"
+curl -s $BASE_URL/upload/put_test.bin -o put_download.bin
+if cmp -s put_test.bin put_download.bin; then
+    echo -e "✅ PUT & GET /upload file -> ${GREEN}PASS${NC}"
+    ((PASS_COUNT++))
+else
+    echo -e "❌ PUT & GET /upload file -> ${RED}FAIL${NC} (content mismatch)"
+    ((FAIL_COUNT++))
+fi
+# A 204 has no body, so a second request on the same connection still parses
+OUT=$(curl -s -v -T upload_test.txt $BASE_URL/upload/put_test.bin -o put_replace.out \
+    --next $BASE_URL/upload/put_test.bin -o /dev/null 2>&1)
+if [[ ! -s put_replace.out && "$OUT" == *"< HTTP/1.1 204"* && "$OUT" == *"< HTTP/1.1 200"* \
+      && "$OUT" == *"Re-using existing connection"* && "$OUT" != *"Excess found"* ]]; then
+    echo -e "✅ PUT replace: empty 204, connection reused -> ${GREEN}PASS${NC}"
+    ((PASS_COUNT++))
+else
+    echo -e "❌ PUT replace: empty 204, connection reused -> ${RED}FAIL${NC}"
+    ((FAIL_COUNT++))
+fi
+curl -s -o /dev/null -X DELETE $BASE_URL/upload/put_test.bin
+rm -f put_test.bin put_download.bin put_replace.out
+
+# --------------------
+# Body over the location limit: refused before curl sends it
+head -c 3000000 /dev/zero > upload_big.bin
+CODE=$(curl -s -o /dev/null -w "%{http_code}" -H "Expect: 100-continue" --data-binary @upload_big.bin $BASE_URL/upload)
+print_result $CODE 413 "POST over client_max_body_size (Expect: 100-continue)"
+rm -f upload_big.bin
+
 # --------------------
 # CGI TESTS
 
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+# Minimal FastCGI responder for test_fastcgi.sh.
+# Usage: fastcgi_responder.py /path/to.sock
+# Answers every request with "conn=<n> method=<m> body=<bytes>", where n
+# numbers the backend connections, so a reused connection shows up as the
+# same n across requests.
+
+import os
+import socket
+import struct
+import sys
+import threading
+
+BEGIN_REQUEST, END_REQUEST, PARAMS, STDIN, STDOUT = 1, 3, 4, 5, 6
+KEEP_CONN = 1
+
+connections = [0]
+counter = threading.Lock()
+
+
+def read_record(f):
+    header = f.read(8)
+    if len(header) < 8:
+        return None
+    _, kind, request_id, length, padding, _ = struct.unpack("!BBHHBB", header)
+    content = f.read(length)
+    f.read(padding)
+    return kind, request_id, content
+
+
+def record(kind, request_id, content):
+    return struct.pack("!BBHHBB", 1, kind, request_id, len(content), 0, 0) + content
+
+
+def parse_params(data):
+    params, i = {}, 0
+
+    def length():
+        nonlocal i
+        if data[i] < 128:
+            i += 1
+            return data[i - 1]
+        i += 4
+        return struct.unpack("!I", data[i - 4:i])[0] & 0x7fffffff
+
+    while i < len(data):
+        name_len = length()
+        value_len = length()
+        params[data[i:i + name_len].decode()] = data[i + name_len:i + name_len + value_len].decode()
+        i += name_len + value_len
+    return params
+
+
+def serve(conn):
+    with counter:
+        connections[0] += 1
+        number = connections[0]
+    f = conn.makefile("rb")
+    while True:
+        begin = read_record(f)
+        if not begin or begin[0] != BEGIN_REQUEST:
+            break
+        request_id, keep = begin[1], begin[2][2] & KEEP_CONN
+        params, body = b"", b""
+        for stream in (PARAMS, STDIN):
+            while True:
+                rec = read_record(f)
+                if not rec:
+                    conn.close()
+                    return
+                if rec[0] != stream:
+                    continue
+                if not rec[2]:
+                    break
+                if stream == PARAMS:
+                    params += rec[2]
+                else:
+                    body += rec[2]
+        env = parse_params(params)
+        out = ("Content-Type: text/plain\r\n\r\nconn=%d method=%s body=%d"
+               % (number, env.get("REQUEST_METHOD"), len(body))).encode()
+        conn.sendall(record(STDOUT, request_id, out) + record(STDOUT, request_id, b"")
+                     + record(END_REQUEST, request_id, struct.pack("!IB3x", 0, 0)))
+        if not keep:
+            break
+    conn.close()
+
+
+def main():
+    path = sys.argv[1]
+    if os.path.exists(path):
+        os.unlink(path)
+    server = socket.socket(socket.AF_UNIX)
+    server.bind(path)
+    server.listen(16)
+    while True:
+        conn, _ = server.accept()
+        threading.Thread(target=serve, args=(conn,), daemon=True).start()
+
+
+if __name__ == "__main__":
+    main()